@@ -0,0 +1,725 @@
+//
+//  TPCircularBufferBenchmark.cpp
+//  Circular/Ring buffer implementation
+//
+//  https://github.com/michaeltyson/TPCircularBuffer
+//
+//  Benchmark suite for the core buffer:
+//
+//    throughput  Single producer, single consumer throughput, for message sizes from 8 bytes
+//                to 1 MiB, against a mutex-guarded ring and a mutex-guarded std::deque
+//    pingpong    Round-trip latency of a message bounced between two threads over two buffers
+//    matrix      Ping-pong latency for every pair of CPUs, with each thread pinned
+//    single      Cost of producing and consuming on one thread, atomic and non-atomic, chosen at
+//                runtime with TPCircularBufferSetAtomic or fixed at compile time (static-), as with
+//                TPCIRCULARBUFFER_ATOMIC or the typed buffer's atomicity policies
+//    streaming   Effect of streaming copies for large blocks on DSP work sharing the producer's
+//                thread: time per pass over a cache-sized working set, interleaved with 4 MiB
+//                produces by memcpy or by TPCircularBufferProduceBytes' streaming path
+//    small       Cost of producing and consuming records of 8 to 128 bytes on one thread, by
+//                memcpy or by TPCircularBufferProduceBytes and TPCircularBufferConsumeBytes
+//
+//  Results are written to stdout as CSV, or JSON with --json, one row per measurement,
+//  so runs can be compared to catch regressions. Progress goes to stderr.
+//
+//  With --counters, throughput, pingpong and single also read hardware performance counters
+//  on each thread (Linux perf_event_open), and report cycles, instructions, L1 data cache
+//  misses and last level cache misses per operation. Cross-core cache line transfers (HITM)
+//  have no generic event, so pass the CPU's raw event with --hitm-event, e.g. on recent Intel
+//  --hitm-event=0x04d2 (MEM_LOAD_L3_HIT_RETIRED.XSNP_HITM; check your CPU's event list). If
+//  counters can't be opened, for instance in a VM or with a restrictive perf_event_paranoid,
+//  the benchmarks run without them.
+//
+//  Build and run from the repository root:
+//
+//    cc -O2 -c TPCircularBuffer.c -o TPCircularBuffer.o
+//    c++ -O2 -std=c++11 -I. Benchmark/TPCircularBufferBenchmark.cpp TPCircularBuffer.o -lpthread -o benchmark
+//    ./benchmark [--json] [--quick] [--cpus=0,1,...] [--counters [--hitm-event=CONFIG]]
+//                [throughput] [pingpong] [matrix] [single] [streaming] [small]
+//
+//  With no benchmark names, all are run. --cpus restricts the CPUs used; the first two
+//  run the producer and consumer (or the two ping-pong threads). Pinning is Linux only.
+//
+//  Copyright (C) 2012-2013 A Tasty Pixel
+//
+//  This software is provided 'as-is', without any express or implied
+//  warranty.  In no event will the authors be held liable for any damages
+//  arising from the use of this software.
+//
+//  Permission is granted to anyone to use this software for any purpose,
+//  including commercial applications, and to alter it and redistribute it
+//  freely, subject to the following restrictions:
+//
+//  1. The origin of this software must not be misrepresented; you must not
+//     claim that you wrote the original software. If you use this software
+//     in a product, an acknowledgment in the product documentation would be
+//     appreciated but is not required.
+//
+//  2. Altered source versions must be plainly marked as such, and must not be
+//     misrepresented as being the original software.
+//
+//  3. This notice may not be removed or altered from any source distribution.
+//
+
+#include "TPCircularBuffer.h"
+
+#include <algorithm>
+#include <cerrno>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <deque>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#if defined(__linux__)
+#include <pthread.h>
+#include <sched.h>
+#include <unistd.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <linux/perf_event.h>
+#endif
+
+namespace {
+
+struct Options {
+    bool json = false;
+    bool quick = false;
+    bool counters = false;
+    uint64_t hitmEvent = 0;
+    std::vector<int> cpus;
+};
+
+struct Result {
+    std::string benchmark;
+    std::string variant;
+    int64_t     bytes;
+    int         producerCPU;
+    int         consumerCPU;
+    std::string metric;
+    double      value;
+};
+
+std::vector<Result> results;
+
+void report(const char *benchmark, const char *variant, int64_t bytes, int producerCPU, int consumerCPU,
+            const char *metric, double value) {
+    results.push_back(Result{benchmark, variant, bytes, producerCPU, consumerCPU, metric, value});
+    fprintf(stderr, "%-10s %-16s %8lld bytes  cpus %d,%d  %-12s %.1f\n",
+            benchmark, variant, (long long)bytes, producerCPU, consumerCPU, metric, value);
+}
+
+void writeResults(const Options &options) {
+    if ( options.json ) {
+        printf("[\n");
+        for ( size_t i=0; i<results.size(); i++ ) {
+            const Result &r = results[i];
+            printf("  {\"benchmark\": \"%s\", \"variant\": \"%s\", \"bytes\": %lld, \"producer_cpu\": %d, "
+                   "\"consumer_cpu\": %d, \"metric\": \"%s\", \"value\": %.3f}%s\n",
+                   r.benchmark.c_str(), r.variant.c_str(), (long long)r.bytes, r.producerCPU, r.consumerCPU,
+                   r.metric.c_str(), r.value, i + 1 < results.size() ? "," : "");
+        }
+        printf("]\n");
+    } else {
+        printf("benchmark,variant,bytes,producer_cpu,consumer_cpu,metric,value\n");
+        for ( const Result &r : results ) {
+            printf("%s,%s,%lld,%d,%d,%s,%.3f\n", r.benchmark.c_str(), r.variant.c_str(), (long long)r.bytes,
+                   r.producerCPU, r.consumerCPU, r.metric.c_str(), r.value);
+        }
+    }
+}
+
+#pragma mark - Threads
+
+double now() {
+    return std::chrono::duration<double>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+std::vector<int> availableCPUs() {
+    std::vector<int> cpus;
+#if defined(__linux__)
+    cpu_set_t set;
+    if ( sched_getaffinity(0, sizeof(set), &set) == 0 ) {
+        for ( int cpu=0; cpu<CPU_SETSIZE; cpu++ ) {
+            if ( CPU_ISSET(cpu, &set) ) cpus.push_back(cpu);
+        }
+    }
+#endif
+    if ( cpus.empty() ) {
+        for ( unsigned int cpu=0; cpu<std::max(1u, std::thread::hardware_concurrency()); cpu++ ) {
+            cpus.push_back((int)cpu);
+        }
+    }
+    return cpus;
+}
+
+void pinThread(int cpu) {
+#if defined(__linux__)
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    CPU_SET(cpu, &set);
+    pthread_setaffinity_np(pthread_self(), sizeof(set), &set);
+#else
+    (void)cpu;
+#endif
+}
+
+// Spin briefly, then give up the CPU, so waiting works when both threads share one
+inline void backoff(int &spins) {
+    if ( ++spins < 256 ) {
+#if defined(__x86_64__) || defined(__i386__)
+        __builtin_ia32_pause();
+#elif defined(__aarch64__)
+        __asm__ __volatile__("yield");
+#endif
+    } else {
+        std::this_thread::yield();
+        spins = 0;
+    }
+}
+
+#pragma mark - Hardware counters
+
+struct CounterEvent {
+    const char *name;
+    uint32_t    type;
+    uint64_t    config;
+};
+
+// The events to count, empty unless enabled with --counters
+std::vector<CounterEvent> counterEvents;
+
+#if defined(__linux__)
+uint64_t cacheEvent(uint64_t cache) {
+    return cache | (PERF_COUNT_HW_CACHE_OP_READ << 8) | (PERF_COUNT_HW_CACHE_RESULT_MISS << 16);
+}
+#endif
+
+// Counts events on the thread that calls start, until it calls stop
+class Counters {
+public:
+    Counters() : leader(-1), values(counterEvents.size(), 0) {}
+    Counters(const Counters &) = delete;
+    Counters &operator=(const Counters &) = delete;
+    ~Counters() {
+#if defined(__linux__)
+        for ( int fd : fds ) if ( fd >= 0 ) close(fd);
+#endif
+    }
+
+    void start() {
+#if defined(__linux__)
+        if ( counterEvents.empty() ) return;
+        if ( fds.empty() ) open();
+        if ( leader < 0 ) return;
+        ioctl(leader, PERF_EVENT_IOC_RESET, PERF_IOC_FLAG_GROUP);
+        ioctl(leader, PERF_EVENT_IOC_ENABLE, PERF_IOC_FLAG_GROUP);
+#endif
+    }
+
+    void stop() {
+#if defined(__linux__)
+        if ( leader < 0 ) return;
+        ioctl(leader, PERF_EVENT_IOC_DISABLE, PERF_IOC_FLAG_GROUP);
+
+        // Group format: count, time enabled, time running, then each value in the order opened
+        std::vector<uint64_t> data(3 + fds.size());
+        if ( read(leader, data.data(), data.size() * sizeof(uint64_t)) <= 0 || data[2] == 0 ) return;
+        double scale = (double)data[1] / (double)data[2]; // Extrapolate if the counters were multiplexed
+        for ( size_t i=0, value=0; i<fds.size(); i++ ) {
+            if ( fds[i] >= 0 ) values[i] = (double)data[3 + value++] * scale;
+        }
+#endif
+    }
+
+    void reportPerOperation(const char *benchmark, const char *variant, int64_t bytes, int producerCPU,
+                            int consumerCPU, const char *side, double operations) const {
+        if ( leader < 0 ) return;
+        for ( size_t i=0; i<counterEvents.size(); i++ ) {
+            if ( fds[i] < 0 ) continue;
+            std::string metric = std::string(side) + "_" + counterEvents[i].name + "/op";
+            report(benchmark, variant, bytes, producerCPU, consumerCPU, metric.c_str(), values[i] / operations);
+        }
+    }
+
+private:
+#if defined(__linux__)
+    void open() {
+        static std::mutex warningMutex;
+        static std::vector<std::string> warned;
+        for ( const CounterEvent &event : counterEvents ) {
+            perf_event_attr attributes;
+            memset(&attributes, 0, sizeof(attributes));
+            attributes.size = sizeof(attributes);
+            attributes.type = event.type;
+            attributes.config = event.config;
+            attributes.disabled = leader < 0; // Members follow the leader
+            attributes.exclude_kernel = 1;
+            attributes.exclude_hv = 1;
+            attributes.read_format = PERF_FORMAT_GROUP | PERF_FORMAT_TOTAL_TIME_ENABLED | PERF_FORMAT_TOTAL_TIME_RUNNING;
+            int fd = (int)syscall(SYS_perf_event_open, &attributes, 0, -1, leader, 0);
+            if ( fd < 0 ) {
+                std::lock_guard<std::mutex> lock(warningMutex);
+                if ( std::find(warned.begin(), warned.end(), event.name) == warned.end() ) {
+                    fprintf(stderr, "counters: %s unavailable (%s)\n", event.name, strerror(errno));
+                    warned.push_back(event.name);
+                }
+            } else if ( leader < 0 ) {
+                leader = fd;
+            }
+            fds.push_back(fd);
+        }
+    }
+#endif
+
+    std::vector<int>    fds;
+    int                 leader;
+    std::vector<double> values;
+};
+
+#pragma mark - Queues
+
+// Each queue moves fixed-size messages, copying them in on push and out on pop
+
+class RingQueue {
+public:
+    explicit RingQueue(int32_t capacity) {
+        if ( !TPCircularBufferInit(&buffer, capacity) ) abort();
+    }
+    ~RingQueue() { TPCircularBufferCleanup(&buffer); }
+    bool push(const char *src, int32_t length) {
+        return TPCircularBufferProduceBytes(&buffer, src, length);
+    }
+    bool pop(char *dst, int32_t length) {
+        TPCircularBufferLength available;
+        void *tail = TPCircularBufferTail(&buffer, &available);
+        if ( available < length ) return false;
+        memcpy(dst, tail, length);
+        TPCircularBufferConsume(&buffer, length);
+        return true;
+    }
+    TPCircularBuffer buffer;
+};
+
+class MutexRingQueue {
+public:
+    explicit MutexRingQueue(int32_t capacity) : storage(capacity), head(0), tail(0), fill(0) {}
+    bool push(const char *src, int32_t length) {
+        std::lock_guard<std::mutex> lock(mutex);
+        if ( (int32_t)storage.size() - fill < length ) return false;
+        int32_t first = std::min(length, (int32_t)storage.size() - head);
+        memcpy(&storage[head], src, first);
+        memcpy(&storage[0], src + first, length - first);
+        head = (head + length) % (int32_t)storage.size();
+        fill += length;
+        return true;
+    }
+    bool pop(char *dst, int32_t length) {
+        std::lock_guard<std::mutex> lock(mutex);
+        if ( fill < length ) return false;
+        int32_t first = std::min(length, (int32_t)storage.size() - tail);
+        memcpy(dst, &storage[tail], first);
+        memcpy(dst + first, &storage[0], length - first);
+        tail = (tail + length) % (int32_t)storage.size();
+        fill -= length;
+        return true;
+    }
+private:
+    std::mutex        mutex;
+    std::vector<char> storage;
+    int32_t           head, tail, fill;
+};
+
+class MutexDequeQueue {
+public:
+    explicit MutexDequeQueue(int32_t capacity) : capacity(capacity) {}
+    bool push(const char *src, int32_t length) {
+        std::lock_guard<std::mutex> lock(mutex);
+        if ( (int64_t)bytes.size() + length > capacity ) return false;
+        bytes.insert(bytes.end(), src, src + length);
+        return true;
+    }
+    bool pop(char *dst, int32_t length) {
+        std::lock_guard<std::mutex> lock(mutex);
+        if ( (int64_t)bytes.size() < length ) return false;
+        std::copy(bytes.begin(), bytes.begin() + length, dst);
+        bytes.erase(bytes.begin(), bytes.begin() + length);
+        return true;
+    }
+private:
+    std::mutex       mutex;
+    std::deque<char> bytes;
+    int32_t          capacity;
+};
+
+int32_t queueCapacity(int32_t messageSize) {
+    return std::max(1 << 20, messageSize * 4);
+}
+
+#pragma mark - Throughput
+
+template <class Queue>
+void throughput(const char *variant, int32_t messageSize, int64_t messages, int producerCPU, int consumerCPU) {
+    Queue queue(queueCapacity(messageSize));
+    std::vector<char> source(messageSize, 1), destination(messageSize);
+    volatile uint64_t checksum = 0;
+    Counters producerCounters, consumerCounters;
+
+    double start = now();
+    std::thread consumer([&] {
+        pinThread(consumerCPU);
+        consumerCounters.start();
+        uint64_t sum = 0;
+        int spins = 0;
+        for ( int64_t i=0; i<messages; i++ ) {
+            while ( !queue.pop(destination.data(), messageSize) ) backoff(spins);
+            sum += (uint8_t)destination[0];
+        }
+        consumerCounters.stop();
+        checksum = sum;
+    });
+    std::thread producer([&] {
+        pinThread(producerCPU);
+        producerCounters.start();
+        int spins = 0;
+        for ( int64_t i=0; i<messages; i++ ) {
+            source[0] = (char)i;
+            while ( !queue.push(source.data(), messageSize) ) backoff(spins);
+        }
+        producerCounters.stop();
+    });
+    producer.join();
+    consumer.join();
+    double elapsed = now() - start;
+
+    report("throughput", variant, messageSize, producerCPU, consumerCPU, "MB/s",
+           (double)messages * messageSize / elapsed / 1e6);
+    report("throughput", variant, messageSize, producerCPU, consumerCPU, "messages/s", (double)messages / elapsed);
+    producerCounters.reportPerOperation("throughput", variant, messageSize, producerCPU, consumerCPU, "producer", messages);
+    consumerCounters.reportPerOperation("throughput", variant, messageSize, producerCPU, consumerCPU, "consumer", messages);
+}
+
+void runThroughput(const Options &options) {
+    int producerCPU = options.cpus[0];
+    int consumerCPU = options.cpus[std::min<size_t>(1, options.cpus.size() - 1)];
+    int64_t totalBytes = options.quick ? (16LL << 20) : (256LL << 20);
+    int64_t maxMessages = options.quick ? 200000 : 4000000;
+    for ( int32_t messageSize : {8, 64, 512, 4096, 32768, 262144, 1048576} ) {
+        int64_t messages = std::max<int64_t>(std::min(totalBytes / messageSize, maxMessages), 100);
+        throughput<RingQueue>("tpcb", messageSize, messages, producerCPU, consumerCPU);
+        throughput<MutexRingQueue>("mutex-ring", messageSize, messages, producerCPU, consumerCPU);
+        throughput<MutexDequeQueue>("mutex-deque", messageSize, messages, producerCPU, consumerCPU);
+    }
+}
+
+#pragma mark - Ping-pong
+
+template <class Queue>
+void pingPong(const char *benchmark, const char *variant, int iterations, int cpuA, int cpuB, bool detail) {
+    static const int32_t kMessageSize = 8;
+    Queue there(queueCapacity(kMessageSize)), back(queueCapacity(kMessageSize));
+    std::vector<double> roundTrips(iterations);
+    Counters senderCounters, echoCounters;
+
+    std::thread echo([&] {
+        pinThread(cpuB);
+        if ( detail ) echoCounters.start();
+        char message[kMessageSize];
+        int spins = 0;
+        for ( int i=0; i<iterations; i++ ) {
+            while ( !there.pop(message, kMessageSize) ) backoff(spins);
+            while ( !back.push(message, kMessageSize) ) backoff(spins);
+        }
+        echoCounters.stop();
+    });
+
+    pinThread(cpuA);
+    if ( detail ) senderCounters.start();
+    char message[kMessageSize] = {0};
+    int spins = 0;
+    for ( int i=0; i<iterations; i++ ) {
+        double start = now();
+        while ( !there.push(message, kMessageSize) ) backoff(spins);
+        while ( !back.pop(message, kMessageSize) ) backoff(spins);
+        roundTrips[i] = now() - start;
+    }
+    senderCounters.stop();
+    echo.join();
+
+    std::sort(roundTrips.begin(), roundTrips.end());
+    report(benchmark, variant, kMessageSize, cpuA, cpuB, "p50_ns", roundTrips[iterations / 2] * 1e9);
+    if ( detail ) {
+        double sum = 0;
+        for ( double roundTrip : roundTrips ) sum += roundTrip;
+        report(benchmark, variant, kMessageSize, cpuA, cpuB, "p99_ns", roundTrips[(size_t)(iterations * 0.99)] * 1e9);
+        report(benchmark, variant, kMessageSize, cpuA, cpuB, "mean_ns", sum / iterations * 1e9);
+        senderCounters.reportPerOperation(benchmark, variant, kMessageSize, cpuA, cpuB, "sender", iterations);
+        echoCounters.reportPerOperation(benchmark, variant, kMessageSize, cpuA, cpuB, "echo", iterations);
+    }
+}
+
+void runPingPong(const Options &options) {
+    int cpuA = options.cpus[0];
+    int cpuB = options.cpus[std::min<size_t>(1, options.cpus.size() - 1)];
+    int iterations = options.quick ? 20000 : 200000;
+    pingPong<RingQueue>("pingpong", "tpcb", iterations, cpuA, cpuB, true);
+    pingPong<MutexRingQueue>("pingpong", "mutex-ring", iterations, cpuA, cpuB, true);
+    pingPong<MutexDequeQueue>("pingpong", "mutex-deque", iterations, cpuA, cpuB, true);
+}
+
+void runMatrix(const Options &options) {
+#if defined(__linux__)
+    if ( options.cpus.size() < 2 ) {
+        fprintf(stderr, "matrix: skipped, needs at least two CPUs\n");
+        return;
+    }
+    int iterations = options.quick ? 2000 : 20000;
+    for ( int cpuA : options.cpus ) {
+        for ( int cpuB : options.cpus ) {
+            if ( cpuA == cpuB ) continue;
+            pingPong<RingQueue>("matrix", "tpcb", iterations, cpuA, cpuB, false);
+        }
+    }
+    pinThread(options.cpus[0]);
+#else
+    (void)options;
+    fprintf(stderr, "matrix: skipped, thread pinning isn't supported on this platform\n");
+#endif
+}
+
+#pragma mark - Single thread
+
+// Atomic is -1 to test the buffer's setting on every call, as the public functions do, or else
+// fixed at compile time
+template <int Atomic>
+__attribute__((noinline)) void produceConsume(TPCircularBuffer *buffer, const char *source, char *destination,
+                                              int32_t messageSize, int64_t iterations) {
+    for ( int64_t i=0; i<iterations; i++ ) {
+        TPCircularBufferLength available;
+        if ( Atomic < 0 ) {
+            TPCircularBufferProduceBytes(buffer, source, messageSize);
+            void *tail = TPCircularBufferTail(buffer, &available);
+            memcpy(destination, tail, messageSize);
+            TPCircularBufferConsume(buffer, messageSize);
+        } else {
+            _TPCircularBufferProduceBytes(buffer, source, messageSize, Atomic);
+            void *tail = _TPCircularBufferTail(buffer, &available, Atomic);
+            memcpy(destination, tail, messageSize);
+            _TPCircularBufferAdvanceTail(buffer, messageSize, Atomic);
+        }
+    }
+}
+
+void runSingle(const Options &options) {
+    pinThread(options.cpus[0]);
+    int64_t iterations = options.quick ? 2000000 : 20000000;
+    struct Variant {
+        const char *name;
+        bool        atomic;
+        void      (*run)(TPCircularBuffer *, const char *, char *, int32_t, int64_t);
+    };
+    const Variant variants[] = {
+        {"atomic", true, produceConsume<-1>},
+        {"nonatomic", false, produceConsume<-1>},
+        {"static-atomic", true, produceConsume<1>},
+        {"static-nonatomic", false, produceConsume<0>},
+    };
+    for ( int32_t messageSize : {8, 64, 512} ) {
+        for ( const Variant &variant : variants ) {
+            RingQueue queue(queueCapacity(messageSize));
+            TPCircularBufferSetAtomic(&queue.buffer, variant.atomic);
+            std::vector<char> source(messageSize, 1), destination(messageSize);
+            variant.run(&queue.buffer, source.data(), destination.data(), messageSize, iterations / 10); // Warm up
+            Counters counters;
+            counters.start();
+            double start = now();
+            variant.run(&queue.buffer, source.data(), destination.data(), messageSize, iterations);
+            double elapsed = now() - start;
+            counters.stop();
+            report("single", variant.name, messageSize, options.cpus[0], options.cpus[0], "ns/pair", elapsed / iterations * 1e9);
+            counters.reportPerOperation("single", variant.name, messageSize, options.cpus[0], options.cpus[0], "thread", iterations);
+        }
+    }
+}
+
+#pragma mark - Streaming
+
+// Stands in for DSP work on the producer's thread: a gain pass over a working set that fits in cache,
+// limited by how fast the working set can be read and written, so it shows when it's been evicted
+float dspPass(std::vector<float> &state) {
+    for ( size_t i=0; i<state.size(); i++ ) {
+        state[i] = state[i] * 0.999f + 0.001f;
+    }
+    return state[state.size() / 2];
+}
+
+void streaming(bool streamingCopies, int32_t blockSize, int blocks, size_t workingSet, int producerCPU, int consumerCPU) {
+    const char *variant = streamingCopies ? "streaming" : "memcpy";
+    RingQueue queue(blockSize * 4);
+    std::vector<char> source(blockSize, 1), destination(blockSize);
+    std::vector<float> state(workingSet / sizeof(float), 1.0f);
+    std::vector<double> passes(blocks);
+    volatile float result = 0;
+
+    std::thread consumer([&] {
+        pinThread(consumerCPU);
+        int spins = 0;
+        for ( int i=0; i<blocks; i++ ) {
+            if ( streamingCopies ) {
+                while ( !TPCircularBufferConsumeBytes(&queue.buffer, destination.data(), blockSize) ) backoff(spins);
+            } else {
+                while ( !queue.pop(destination.data(), blockSize) ) backoff(spins);
+            }
+        }
+    });
+
+    pinThread(producerCPU);
+    dspPass(state); // Warm up
+    double start = now();
+    for ( int i=0; i<blocks; i++ ) {
+        double passStart = now();
+        result = result + dspPass(state);
+        passes[i] = now() - passStart;
+
+        int spins = 0;
+        if ( streamingCopies ) {
+            while ( !TPCircularBufferProduceBytes(&queue.buffer, source.data(), blockSize) ) backoff(spins);
+        } else {
+            TPCircularBufferLength available, discard;
+            char *head;
+            while ( !(head = (char *)TPCircularBufferHead(&queue.buffer, &available, &discard)) || available < blockSize ) {
+                backoff(spins);
+            }
+            memcpy(head, source.data(), blockSize);
+            TPCircularBufferProduce(&queue.buffer, blockSize);
+        }
+    }
+    consumer.join();
+    double elapsed = now() - start;
+
+    std::sort(passes.begin(), passes.end());
+    report("streaming", variant, blockSize, producerCPU, consumerCPU, "dsp_p50_us", passes[blocks / 2] * 1e6);
+    report("streaming", variant, blockSize, producerCPU, consumerCPU, "MB/s", (double)blocks * blockSize / elapsed / 1e6);
+}
+
+void runStreaming(const Options &options) {
+    int producerCPU = options.cpus[0];
+    int consumerCPU = options.cpus[std::min<size_t>(1, options.cpus.size() - 1)];
+    int blocks = options.quick ? 50 : 500;
+    if ( TPCIRCULARBUFFER_STREAMING_THRESHOLD == 0 || TPCIRCULARBUFFER_STREAMING_THRESHOLD > (4 << 20) ) {
+        fprintf(stderr, "streaming: TPCIRCULARBUFFER_STREAMING_THRESHOLD is off or above the block size; "
+                        "both variants will use memcpy\n");
+    }
+    for ( size_t workingSet : {256 << 10, 1 << 20} ) {
+        for ( bool streamingCopies : {false, true} ) {
+            fprintf(stderr, "streaming: %zu KiB DSP working set\n", workingSet >> 10);
+            streaming(streamingCopies, 4 << 20, blocks, workingSet, producerCPU, consumerCPU);
+        }
+    }
+}
+
+#pragma mark - Small records
+
+void smallRecords(bool inlineCopies, int32_t recordSize, int64_t iterations, TPCircularBuffer *buffer, const char *source,
+                  char *destination) {
+    for ( int64_t i=0; i<iterations; i++ ) {
+        if ( inlineCopies ) {
+            TPCircularBufferProduceBytes(buffer, source, recordSize);
+            TPCircularBufferConsumeBytes(buffer, destination, recordSize);
+        } else {
+            TPCircularBufferLength available, discard;
+            void *head = TPCircularBufferHead(buffer, &available, &discard);
+            memcpy(head, source, recordSize);
+            TPCircularBufferProduce(buffer, recordSize);
+            void *tail = TPCircularBufferTail(buffer, &available);
+            memcpy(destination, tail, recordSize);
+            TPCircularBufferConsume(buffer, recordSize);
+        }
+    }
+}
+
+void runSmall(const Options &options) {
+    pinThread(options.cpus[0]);
+    int64_t iterations = options.quick ? 2000000 : 20000000;
+    for ( int32_t size : {8, 12, 16, 24, 32, 48, 64, 100, 128} ) {
+        // Not known at compile time, as with records whose size varies
+        volatile int32_t recordSize = size;
+        for ( bool inlineCopies : {false, true} ) {
+            RingQueue queue(queueCapacity(recordSize));
+            std::vector<char> source(recordSize, 1), destination(recordSize);
+            smallRecords(inlineCopies, recordSize, iterations / 10, &queue.buffer, source.data(), destination.data()); // Warm up
+            double start = now();
+            smallRecords(inlineCopies, recordSize, iterations, &queue.buffer, source.data(), destination.data());
+            double elapsed = now() - start;
+            report("small", inlineCopies ? "inline" : "memcpy", recordSize, options.cpus[0], options.cpus[0], "ns/record",
+                   elapsed / iterations * 1e9);
+        }
+    }
+}
+
+} // namespace
+
+int main(int argc, char *argv[]) {
+    Options options;
+    std::vector<std::string> benchmarks;
+    for ( int i=1; i<argc; i++ ) {
+        std::string argument = argv[i];
+        if ( argument == "--json" ) {
+            options.json = true;
+        } else if ( argument == "--quick" ) {
+            options.quick = true;
+        } else if ( argument == "--counters" ) {
+            options.counters = true;
+        } else if ( argument.compare(0, 13, "--hitm-event=") == 0 ) {
+            options.hitmEvent = strtoull(argument.c_str() + 13, NULL, 0);
+        } else if ( argument.compare(0, 7, "--cpus=") == 0 ) {
+            for ( const char *cpu = argument.c_str() + 7; *cpu; ) {
+                char *end;
+                options.cpus.push_back((int)strtol(cpu, &end, 10));
+                cpu = *end == ',' ? end + 1 : end;
+                if ( end == cpu ) break;
+            }
+        } else if ( argument == "throughput" || argument == "pingpong" || argument == "matrix" || argument == "single"
+                    || argument == "streaming" || argument == "small" ) {
+            benchmarks.push_back(argument);
+        } else {
+            fprintf(stderr, "Usage: %s [--json] [--quick] [--cpus=0,1,...] [--counters [--hitm-event=CONFIG]]\n"
+                            "       [throughput] [pingpong] [matrix] [single] [streaming] [small]\n", argv[0]);
+            return 1;
+        }
+    }
+    if ( options.cpus.empty() ) options.cpus = availableCPUs();
+    if ( benchmarks.empty() ) benchmarks = {"throughput", "pingpong", "matrix", "single", "streaming", "small"};
+
+    if ( options.counters ) {
+#if defined(__linux__)
+        counterEvents = {
+            {"cycles", PERF_TYPE_HARDWARE, PERF_COUNT_HW_CPU_CYCLES},
+            {"instructions", PERF_TYPE_HARDWARE, PERF_COUNT_HW_INSTRUCTIONS},
+            {"l1d_misses", PERF_TYPE_HW_CACHE, cacheEvent(PERF_COUNT_HW_CACHE_L1D)},
+            {"llc_misses", PERF_TYPE_HW_CACHE, cacheEvent(PERF_COUNT_HW_CACHE_LL)},
+        };
+        if ( options.hitmEvent ) {
+            counterEvents.push_back({"hitm", PERF_TYPE_RAW, options.hitmEvent});
+        }
+#else
+        fprintf(stderr, "counters: unavailable on this platform\n");
+#endif
+    }
+
+    for ( const std::string &benchmark : benchmarks ) {
+        if ( benchmark == "throughput" ) runThroughput(options);
+        if ( benchmark == "pingpong" ) runPingPong(options);
+        if ( benchmark == "matrix" ) runMatrix(options);
+        if ( benchmark == "single" ) runSingle(options);
+        if ( benchmark == "streaming" ) runStreaming(options);
+        if ( benchmark == "small" ) runSmall(options);
+    }
+
+    writeResults(options);
+    return 0;
+}
@@ -0,0 +1,96 @@
+//
+//  TPCircularBufferIndexBenchmark.c
+//  Circular/Ring buffer implementation
+//
+//  https://github.com/michaeltyson/TPCircularBuffer
+//
+//  Measures the cost of a TPCircularBufferProduce/TPCircularBufferConsume pair on a single
+//  thread, against a reference that wraps the head and tail with an integer modulo, as
+//  TPCircularBuffer did previously.
+//
+//  Build and run from the repository root:
+//
+//    cc -O2 -I. Benchmark/TPCircularBufferIndexBenchmark.c TPCircularBuffer.c -o index-benchmark
+//    ./index-benchmark
+//
+//  Copyright (C) 2012-2013 A Tasty Pixel
+//
+//  This software is provided 'as-is', without any express or implied
+//  warranty.  In no event will the authors be held liable for any damages
+//  arising from the use of this software.
+//
+//  Permission is granted to anyone to use this software for any purpose,
+//  including commercial applications, and to alter it and redistribute it
+//  freely, subject to the following restrictions:
+//
+//  1. The origin of this software must not be misrepresented; you must not
+//     claim that you wrote the original software. If you use this software
+//     in a product, an acknowledgment in the product documentation would be
+//     appreciated but is not required.
+//
+//  2. Altered source versions must be plainly marked as such, and must not be
+//     misrepresented as being the original software.
+//
+//  3. This notice may not be removed or altered from any source distribution.
+//
+
+#include "TPCircularBuffer.h"
+
+#include <stdio.h>
+#include <time.h>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#define CYCLE_UNIT "cycles"
+static inline uint64_t timestamp(void) { return __rdtsc(); }
+#else
+#define CYCLE_UNIT "ns"
+static inline uint64_t timestamp(void) {
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (uint64_t)now.tv_sec * 1000000000ull + (uint64_t)now.tv_nsec;
+}
+#endif
+
+static const int kIterations = 50000000;
+
+// Previous index update, kept here for comparison
+static __attribute__((noinline)) void produceConsumeModulo(TPCircularBuffer *buffer, const volatile int32_t *amount) {
+    for ( int i=0; i<kIterations; i++ ) {
+        int32_t bytes = *amount;
+        buffer->head = (buffer->head + bytes) % buffer->length;
+        buffer->tail = (buffer->tail + bytes) % buffer->length;
+    }
+}
+
+static __attribute__((noinline)) void produceConsume(TPCircularBuffer *buffer, const volatile int32_t *amount) {
+    for ( int i=0; i<kIterations; i++ ) {
+        int32_t bytes = *amount;
+        TPCircularBufferProduce(buffer, bytes);
+        TPCircularBufferConsume(buffer, bytes);
+    }
+}
+
+static void run(const char *name, TPCircularBuffer *buffer, bool atomic,
+                void (*body)(TPCircularBuffer *, const volatile int32_t *)) {
+    static const volatile int32_t amount = 96; // Not a divisor of the length, so the offsets wrap unevenly
+    TPCircularBufferClear(buffer);
+    TPCircularBufferSetAtomic(buffer, atomic);
+    body(buffer, &amount); // Warm up
+    uint64_t start = timestamp();
+    body(buffer, &amount);
+    uint64_t end = timestamp();
+    printf("%-28s %6.2f %s per produce/consume pair\n", name, (double)(end - start) / kIterations, CYCLE_UNIT);
+}
+
+int main(void) {
+    TPCircularBuffer buffer;
+    if ( !TPCircularBufferInit(&buffer, 16384) ) return 1;
+    
+    run("modulo, index update only", &buffer, false, produceConsumeModulo);
+    run("current, non-atomic", &buffer, false, produceConsume);
+    run("current, atomic", &buffer, true, produceConsume);
+    
+    TPCircularBufferCleanup(&buffer);
+    return 0;
+}
@@ -0,0 +1,184 @@
+//
+//  TPCircularBufferOverwriteStress.c
+//  Circular/Ring buffer implementation
+//
+//  https://github.com/michaeltyson/TPCircularBuffer
+//
+//  Stress test for overwrite mode: a producer that never waits, writing chunks of random
+//  sizes with TPCircularBufferHeadOverwriting and TPCircularBufferProduceBytesOverwriting,
+//  against a consumer reading random amounts with TPCircularBufferConsumeBytesOverwriting.
+//
+//  Every byte written is derived from its position in the stream, so the consumer can check
+//  that each byte it reads is the one at its position, counting the bytes it has read plus
+//  the bytes reported lost. At the end, the bytes read plus the bytes lost must equal the
+//  bytes written. Any torn, duplicated or misplaced byte, or any loss that isn't reported,
+//  fails the test.
+//
+//  Build and run from the repository root:
+//
+//    cc -O2 -DTPCIRCULARBUFFER_CACHED_INDICES=1 -I. Benchmark/TPCircularBufferOverwriteStress.c TPCircularBuffer.c TPCircularBuffer+Overwrite.c -lpthread -o overwrite-stress
+//    ./overwrite-stress [megabytes]
+//
+//  Add -DTPCIRCULARBUFFER_STATS=1 to also check the statistics against the totals.
+//
+//  Copyright (C) 2012-2013 A Tasty Pixel
+//
+//  This software is provided 'as-is', without any express or implied
+//  warranty.  In no event will the authors be held liable for any damages
+//  arising from the use of this software.
+//
+//  Permission is granted to anyone to use this software for any purpose,
+//  including commercial applications, and to alter it and redistribute it
+//  freely, subject to the following restrictions:
+//
+//  1. The origin of this software must not be misrepresented; you must not
+//     claim that you wrote the original software. If you use this software
+//     in a product, an acknowledgment in the product documentation would be
+//     appreciated but is not required.
+//
+//  2. Altered source versions must be plainly marked as such, and must not be
+//     misrepresented as being the original software.
+//
+//  3. This notice may not be removed or altered from any source distribution.
+//
+
+#include "TPCircularBuffer.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <pthread.h>
+#include <sched.h>
+
+#if TPCIRCULARBUFFER_CACHED_INDICES
+
+#include "TPCircularBuffer+Overwrite.h"
+
+static const int32_t kLength = 65536;
+static const int32_t kMaxChunk = 16384;
+
+typedef struct {
+    TPCircularBuffer buffer;
+    uint64_t         total;        // Bytes to produce
+    atomic_int       finished;     // Set once the producer has produced them all
+    uint64_t         produced;
+} Test;
+
+// The byte at a stream position; multiplying spreads each position's bits, so any offset shows
+static uint8_t patternByte(uint64_t position) {
+    return (uint8_t)((position * 0x9E3779B97F4A7C15ull) >> 56);
+}
+
+static uint32_t randomNumber(uint32_t *state) {
+    *state ^= *state << 13;
+    *state ^= *state >> 17;
+    *state ^= *state << 5;
+    return *state;
+}
+
+static void *producer(void *context) {
+    Test *test = (Test *)context;
+    uint8_t *chunk = (uint8_t *)malloc(kMaxChunk);
+    uint32_t random = 0x12345678;
+    uint64_t position = 0;
+    while ( position < test->total ) {
+        int32_t length = (int32_t)(randomNumber(&random) % kMaxChunk) + 1;
+        if ( (uint64_t)length > test->total - position ) length = (int32_t)(test->total - position);
+        if ( random & 0x100 ) {
+            // Write in place
+            uint8_t *head = (uint8_t *)TPCircularBufferHeadOverwriting(&test->buffer, length, NULL);
+            for ( int32_t i=0; i<length; i++ ) head[i] = patternByte(position + (uint64_t)i);
+            TPCircularBufferProduce(&test->buffer, length);
+        } else {
+            for ( int32_t i=0; i<length; i++ ) chunk[i] = patternByte(position + (uint64_t)i);
+            TPCircularBufferProduceBytesOverwriting(&test->buffer, chunk, length);
+        }
+        position += (uint64_t)length;
+        if ( (random & 0xf000) == 0 ) sched_yield(); // Let the consumer in, even on a single CPU
+    }
+    free(chunk);
+    test->produced = position;
+    atomic_store_explicit(&test->finished, 1, memory_order_release);
+    return NULL;
+}
+
+int main(int argc, char *argv[]) {
+    uint64_t megabytes = argc > 1 ? strtoull(argv[1], NULL, 10) : 1024;
+
+    static Test test;
+    if ( !TPCircularBufferInit(&test.buffer, kLength) ) {
+        fprintf(stderr, "Couldn't create buffer\n");
+        return 1;
+    }
+    test.total = megabytes << 20;
+    atomic_store_explicit(&test.finished, 0, memory_order_relaxed);
+
+    pthread_t thread;
+    pthread_create(&thread, NULL, producer, &test);
+
+    uint8_t *chunk = (uint8_t *)malloc(kMaxChunk);
+    uint32_t random = 0x9abcdef0;
+    uint64_t position = 0, consumed = 0, lost = 0, reads = 0, losses = 0;
+    bool drained = false;
+    while ( !drained ) {
+        // Once the producer has finished, a read that finds nothing means everything has been seen
+        bool finished = atomic_load_explicit(&test.finished, memory_order_acquire);
+        int32_t length = (int32_t)(randomNumber(&random) % kMaxChunk) + 1;
+        TPCircularBufferLength lostBytes;
+        TPCircularBufferLength amount = TPCircularBufferConsumeBytesOverwriting(&test.buffer, chunk, length, &lostBytes);
+        if ( lostBytes < 0 || amount < 0 || amount > length ) {
+            fprintf(stderr, "FAIL: read %lld bytes, lost %lld, asking for %d\n",
+                    (long long)amount, (long long)lostBytes, length);
+            return 1;
+        }
+        if ( lostBytes > 0 ) losses++;
+        position += (uint64_t)lostBytes;
+        lost += (uint64_t)lostBytes;
+        for ( TPCircularBufferLength i=0; i<amount; i++ ) {
+            if ( chunk[i] != patternByte(position + (uint64_t)i) ) {
+                fprintf(stderr, "FAIL: byte at stream position %llu is %d, expected %d\n",
+                        (unsigned long long)(position + (uint64_t)i), chunk[i], patternByte(position + (uint64_t)i));
+                return 1;
+            }
+        }
+        position += (uint64_t)amount;
+        consumed += (uint64_t)amount;
+        if ( amount > 0 ) reads++;
+        if ( amount == 0 && lostBytes == 0 ) {
+            if ( finished ) drained = true;
+            else sched_yield();
+        }
+    }
+    pthread_join(thread, NULL);
+    free(chunk);
+
+    printf("produced %llu bytes, consumed %llu in %llu reads, lost %llu in %llu losses\n",
+           (unsigned long long)test.produced, (unsigned long long)consumed, (unsigned long long)reads,
+           (unsigned long long)lost, (unsigned long long)losses);
+    if ( consumed + lost != test.produced ) {
+        fprintf(stderr, "FAIL: consumed plus lost is %llu, not %llu\n",
+                (unsigned long long)(consumed + lost), (unsigned long long)test.produced);
+        return 1;
+    }
+#if TPCIRCULARBUFFER_STATS
+    TPCircularBufferStats stats;
+    TPCircularBufferGetStats(&test.buffer, &stats);
+    if ( stats.bytesProduced != test.produced || stats.bytesConsumed != consumed || stats.bytesLost != lost ) {
+        fprintf(stderr, "FAIL: statistics report %llu produced, %llu consumed, %llu lost\n",
+                (unsigned long long)stats.bytesProduced, (unsigned long long)stats.bytesConsumed,
+                (unsigned long long)stats.bytesLost);
+        return 1;
+    }
+#endif
+    TPCircularBufferCleanup(&test.buffer);
+    printf("OK\n");
+    return 0;
+}
+
+#else
+
+int main(void) {
+    fprintf(stderr, "Overwrite mode requires TPCIRCULARBUFFER_CACHED_INDICES; build with -DTPCIRCULARBUFFER_CACHED_INDICES=1\n");
+    return 1;
+}
+
+#endif
@@ -0,0 +1,115 @@
+//
+//  TPCircularBufferPoolBenchmark.c
+//  Circular/Ring buffer implementation
+//
+//  https://github.com/michaeltyson/TPCircularBuffer
+//
+//  Measures how quickly buffers can be created and destroyed, by several threads at
+//  once, with TPCircularBufferInit and TPCircularBufferCleanup, and with a
+//  TPCircularBufferPool.
+//
+//  Build and run from the repository root:
+//
+//    cc -O2 -I. Benchmark/TPCircularBufferPoolBenchmark.c TPCircularBuffer.c TPCircularBuffer+Pool.c -lpthread -o pool-benchmark
+//    ./pool-benchmark
+//
+//  Copyright (C) 2012-2013 A Tasty Pixel
+//
+//  This software is provided 'as-is', without any express or implied
+//  warranty.  In no event will the authors be held liable for any damages
+//  arising from the use of this software.
+//
+//  Permission is granted to anyone to use this software for any purpose,
+//  including commercial applications, and to alter it and redistribute it
+//  freely, subject to the following restrictions:
+//
+//  1. The origin of this software must not be misrepresented; you must not
+//     claim that you wrote the original software. If you use this software
+//     in a product, an acknowledgment in the product documentation would be
+//     appreciated but is not required.
+//
+//  2. Altered source versions must be plainly marked as such, and must not be
+//     misrepresented as being the original software.
+//
+//  3. This notice may not be removed or altered from any source distribution.
+//
+
+#if defined(__linux__) && !defined(_GNU_SOURCE)
+#define _GNU_SOURCE // For CLOCK_MONOTONIC
+#endif
+
+#include "TPCircularBuffer.h"
+#include "TPCircularBuffer+Pool.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+#include <pthread.h>
+
+static const int kIterations = 20000;
+static const int32_t kLength = 65536;
+static const int kBuffersPerThread = 4; // Each thread holds a few buffers at once, like a server handling several streams
+
+typedef struct {
+    TPCircularBufferPool *pool;
+} Job;
+
+static double now(void) {
+    struct timespec time;
+    clock_gettime(CLOCK_MONOTONIC, &time);
+    return (double)time.tv_sec + (double)time.tv_nsec * 1e-9;
+}
+
+static void *worker(void *context) {
+    const Job *job = (const Job *)context;
+    TPCircularBuffer buffers[kBuffersPerThread];
+    for ( int i=0; i<kIterations; i++ ) {
+        for ( int j=0; j<kBuffersPerThread; j++ ) {
+            bool result = job->pool
+                ? TPCircularBufferPoolInit(job->pool, &buffers[j], kLength)
+                : TPCircularBufferInit(&buffers[j], kLength);
+            if ( !result ) abort();
+            // Touch the buffer, as a new stream would
+            TPCircularBufferLength space, discard;
+            *(volatile char *)TPCircularBufferHead(&buffers[j], &space, &discard) = 0;
+        }
+        for ( int j=0; j<kBuffersPerThread; j++ ) {
+            if ( job->pool ) {
+                TPCircularBufferPoolCleanup(job->pool, &buffers[j]);
+            } else {
+                TPCircularBufferCleanup(&buffers[j]);
+            }
+        }
+    }
+    return NULL;
+}
+
+static void run(const char *name, int threadCount, TPCircularBufferPool *pool) {
+    pthread_t threads[threadCount];
+    Job job = { pool };
+    double start = now();
+    for ( int i=0; i<threadCount; i++ ) {
+        pthread_create(&threads[i], NULL, worker, &job);
+    }
+    for ( int i=0; i<threadCount; i++ ) {
+        pthread_join(threads[i], NULL);
+    }
+    double elapsed = now() - start;
+    double pairs = (double)threadCount * kIterations * kBuffersPerThread;
+    printf("%-8s %2d threads: %8.2f us per init/cleanup pair, %10.0f pairs/s\n",
+           name, threadCount, elapsed / pairs * 1e6, pairs / elapsed);
+}
+
+int main(void) {
+    static const int kThreadCounts[] = { 1, 2, 4, 8 };
+    for ( size_t i=0; i<sizeof(kThreadCounts)/sizeof(kThreadCounts[0]); i++ ) {
+        int threadCount = kThreadCounts[i];
+        run("direct", threadCount, NULL);
+
+        TPCircularBufferPool *pool = TPCircularBufferPoolCreate(threadCount * kBuffersPerThread);
+        if ( !pool || !TPCircularBufferPoolReserve(pool, kLength, threadCount * kBuffersPerThread) ) return 1;
+        run("pool", threadCount, pool);
+        TPCircularBufferPoolDestroy(pool);
+    }
+    return 0;
+}
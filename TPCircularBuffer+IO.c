@@ -0,0 +1,222 @@
+//
+//  TPCircularBuffer+IO.c
+//  Circular/Ring buffer implementation
+//
+//  https://github.com/michaeltyson/TPCircularBuffer
+//
+//  Copyright (C) 2012-2013 A Tasty Pixel
+//
+//  This software is provided 'as-is', without any express or implied
+//  warranty.  In no event will the authors be held liable for any damages
+//  arising from the use of this software.
+//
+//  Permission is granted to anyone to use this software for any purpose,
+//  including commercial applications, and to alter it and redistribute it
+//  freely, subject to the following restrictions:
+//
+//  1. The origin of this software must not be misrepresented; you must not
+//     claim that you wrote the original software. If you use this software
+//     in a product, an acknowledgment in the product documentation would be
+//     appreciated but is not required.
+//
+//  2. Altered source versions must be plainly marked as such, and must not be
+//     misrepresented as being the original software.
+//
+//  3. This notice may not be removed or altered from any source distribution.
+//
+
+#if defined(__linux__) && !defined(_GNU_SOURCE)
+#define _GNU_SOURCE // For recvmmsg and sendmmsg
+#endif
+
+#include "TPCircularBuffer+IO.h"
+
+#include <errno.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <sys/uio.h>
+
+#pragma mark - Buffer access
+
+/*!
+ * Access the free space at the front of the buffer
+ *
+ *  A system call costs far more than looking at the consumer's position, so always
+ *  start from an up-to-date view of it.
+ */
+static char *freeSpace(TPCircularBuffer *buffer, TPCircularBufferLength maxLength, TPCircularBufferLength *length) {
+#if TPCIRCULARBUFFER_CACHED_INDICES
+    _TPCircularBufferProducerFillCount(buffer, _TPCircularBufferAtomic(buffer), true);
+#endif
+    TPCircularBufferLength discard;
+    char *ptr = (char *)TPCircularBufferHead(buffer, length, &discard);
+    if ( maxLength > 0 && *length > maxLength ) *length = maxLength;
+    return ptr;
+}
+
+static const char *availableBytes(TPCircularBuffer *buffer, TPCircularBufferLength maxLength, TPCircularBufferLength *length) {
+    const char *ptr = (const char *)TPCircularBufferTail(buffer, length);
+    if ( maxLength > 0 && *length > maxLength ) *length = maxLength;
+    return ptr;
+}
+
+#pragma mark - Streams
+
+ssize_t TPCircularBufferProduceFromFileDescriptor(TPCircularBuffer *buffer, int fileDescriptor, TPCircularBufferLength maxLength) {
+    TPCircularBufferLength length;
+    char *ptr = freeSpace(buffer, maxLength, &length);
+    if ( !ptr ) {
+        errno = ENOBUFS;
+        return -1;
+    }
+    ssize_t result = read(fileDescriptor, ptr, (size_t)length);
+    if ( result > 0 ) {
+        TPCircularBufferProduce(buffer, (TPCircularBufferLength)result);
+    }
+    return result;
+}
+
+ssize_t TPCircularBufferConsumeToFileDescriptor(TPCircularBuffer *buffer, int fileDescriptor, TPCircularBufferLength maxLength) {
+    TPCircularBufferLength length;
+    const char *ptr = availableBytes(buffer, maxLength, &length);
+    if ( !ptr ) return 0;
+    ssize_t result = write(fileDescriptor, ptr, (size_t)length);
+    if ( result > 0 ) {
+        TPCircularBufferConsume(buffer, (TPCircularBufferLength)result);
+    }
+    return result;
+}
+
+ssize_t TPCircularBufferProduceFromSocket(TPCircularBuffer *buffer, int socket, TPCircularBufferLength maxLength, int flags) {
+    TPCircularBufferLength length;
+    char *ptr = freeSpace(buffer, maxLength, &length);
+    if ( !ptr ) {
+        errno = ENOBUFS;
+        return -1;
+    }
+    ssize_t result = recv(socket, ptr, (size_t)length, flags);
+    if ( result > 0 ) {
+        TPCircularBufferProduce(buffer, (TPCircularBufferLength)result);
+    }
+    return result;
+}
+
+ssize_t TPCircularBufferConsumeToSocket(TPCircularBuffer *buffer, int socket, TPCircularBufferLength maxLength, int flags) {
+    TPCircularBufferLength length;
+    const char *ptr = availableBytes(buffer, maxLength, &length);
+    if ( !ptr ) return 0;
+    ssize_t result = send(socket, ptr, (size_t)length, flags);
+    if ( result > 0 ) {
+        TPCircularBufferConsume(buffer, (TPCircularBufferLength)result);
+    }
+    return result;
+}
+
+#pragma mark - Datagrams
+
+int TPCircularBufferProduceMessagesFromSocket(TPCircularBuffer *buffer,
+                                              int socket,
+                                              int maxMessages,
+                                              int32_t maxMessageLength,
+                                              int flags) {
+    assert(maxMessages > 0 && maxMessages <= kTPCircularBufferIOMaxMessages);
+
+    // Lay the records out at a fixed stride, as we don't know the message lengths until they arrive
+    int32_t stride = TPCircularBufferRecordTotalLength(maxMessageLength);
+    TPCircularBufferLength space;
+    char *ptr = freeSpace(buffer, 0, &space);
+    TPCircularBufferLength fit = ptr ? space / stride : 0;
+    int count = fit < maxMessages ? (int)fit : maxMessages;
+    if ( count <= 0 ) {
+        errno = ENOBUFS;
+        return -1;
+    }
+
+    struct iovec iovecs[kTPCircularBufferIOMaxMessages];
+    for ( int i=0; i<count; i++ ) {
+        iovecs[i].iov_base = ptr + i*stride + kTPCircularBufferRecordHeaderLength;
+        iovecs[i].iov_len = (size_t)maxMessageLength;
+    }
+
+    int32_t lengths[kTPCircularBufferIOMaxMessages];
+    int received = 0;
+#if defined(__linux__)
+    struct mmsghdr messages[kTPCircularBufferIOMaxMessages];
+    memset(messages, 0, sizeof(messages[0]) * count);
+    for ( int i=0; i<count; i++ ) {
+        messages[i].msg_hdr.msg_iov = &iovecs[i];
+        messages[i].msg_hdr.msg_iovlen = 1;
+    }
+    received = recvmmsg(socket, messages, (unsigned int)count, flags | MSG_WAITFORONE, NULL);
+    if ( received < 0 ) return -1;
+    for ( int i=0; i<received; i++ ) {
+        lengths[i] = (int32_t)messages[i].msg_len;
+    }
+#else
+    // Receive one at a time, waiting only for the first, like recvmmsg with MSG_WAITFORONE
+    for ( ; received<count; received++ ) {
+        ssize_t result = recv(socket, iovecs[received].iov_base, iovecs[received].iov_len,
+                              received == 0 ? flags : flags | MSG_DONTWAIT);
+        if ( result < 0 ) {
+            if ( received == 0 ) return -1;
+            break;
+        }
+        lengths[received] = (int32_t)result;
+    }
+#endif
+
+    for ( int i=0; i<received; i++ ) {
+        TPCircularBufferRecordHeader *header = (TPCircularBufferRecordHeader *)(ptr + i*stride);
+        header->totalLength = stride;
+        header->length = lengths[i];
+    }
+    if ( received > 0 ) {
+        TPCircularBufferProduce(buffer, (TPCircularBufferLength)received * stride);
+    }
+    return received;
+}
+
+int TPCircularBufferConsumeMessagesToSocket(TPCircularBuffer *buffer, int socket, int maxMessages, int flags) {
+    assert(maxMessages > 0 && maxMessages <= kTPCircularBufferIOMaxMessages);
+
+    TPCircularBufferBatch batch;
+    if ( !TPCircularBufferBeginReadBatch(buffer, &batch) ) return 0;
+
+    // Gather the records, noting where each ends so we can release exactly those sent
+    struct iovec iovecs[kTPCircularBufferIOMaxMessages];
+    TPCircularBufferLength ends[kTPCircularBufferIOMaxMessages];
+    int count = 0;
+    const void *record;
+    int32_t length;
+    while ( count < maxMessages && (record = TPCircularBufferBatchNextRecord(&batch, &length)) ) {
+        iovecs[count].iov_base = (void *)record;
+        iovecs[count].iov_len = (size_t)length;
+        ends[count] = batch.length;
+        count++;
+    }
+    if ( count == 0 ) return 0;
+
+    int sent = 0;
+#if defined(__linux__)
+    struct mmsghdr messages[kTPCircularBufferIOMaxMessages];
+    memset(messages, 0, sizeof(messages[0]) * count);
+    for ( int i=0; i<count; i++ ) {
+        messages[i].msg_hdr.msg_iov = &iovecs[i];
+        messages[i].msg_hdr.msg_iovlen = 1;
+    }
+    sent = sendmmsg(socket, messages, (unsigned int)count, flags);
+    if ( sent < 0 ) return -1;
+#else
+    for ( ; sent<count; sent++ ) {
+        if ( send(socket, iovecs[sent].iov_base, iovecs[sent].iov_len, flags) < 0 ) {
+            if ( sent == 0 ) return -1;
+            break;
+        }
+    }
+#endif
+
+    if ( sent > 0 ) {
+        TPCircularBufferConsume(buffer, ends[sent-1]);
+    }
+    return sent;
+}
@@ -0,0 +1,151 @@
+//
+//  TPCircularBuffer+IO.h
+//  Circular/Ring buffer implementation
+//
+//  https://github.com/michaeltyson/TPCircularBuffer
+//
+//  Helpers to move data between the buffer and files or sockets without an
+//  intermediate copy: reads go straight into the front of the buffer, and writes
+//  straight from the end of it. Because of the mirrored mapping, the free space and
+//  the available bytes are always a single contiguous region, so each transfer needs
+//  just one system call and one iovec.
+//
+//  Stream helpers transfer raw bytes. Datagram helpers transfer one message per
+//  record, in the format of TPCircularBuffer+Records.h, using recvmmsg and sendmmsg
+//  where available to move many messages per system call.
+//
+//  Copyright (C) 2012-2013 A Tasty Pixel
+//
+//  This software is provided 'as-is', without any express or implied
+//  warranty.  In no event will the authors be held liable for any damages
+//  arising from the use of this software.
+//
+//  Permission is granted to anyone to use this software for any purpose,
+//  including commercial applications, and to alter it and redistribute it
+//  freely, subject to the following restrictions:
+//
+//  1. The origin of this software must not be misrepresented; you must not
+//     claim that you wrote the original software. If you use this software
+//     in a product, an acknowledgment in the product documentation would be
+//     appreciated but is not required.
+//
+//  2. Altered source versions must be plainly marked as such, and must not be
+//     misrepresented as being the original software.
+//
+//  3. This notice may not be removed or altered from any source distribution.
+//
+
+#ifndef TPCircularBuffer_IO_h
+#define TPCircularBuffer_IO_h
+
+#include "TPCircularBuffer.h"
+#include "TPCircularBuffer+Records.h"
+#include <sys/types.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*!
+ * Maximum number of messages moved by one call to the datagram helpers
+ */
+#define kTPCircularBufferIOMaxMessages 64
+
+#pragma mark - Streams
+
+/*!
+ * Read from a file descriptor into the buffer
+ *
+ *  Calls read once, straight into the free space at the front of the buffer, and
+ *  produces the bytes read. Only call this from the producer thread.
+ *
+ * @param buffer Circular buffer
+ * @param fileDescriptor File descriptor to read from
+ * @param maxLength Maximum number of bytes to read, or 0 for as many as fit
+ * @return Number of bytes read, 0 at end of file, or -1 on error (with errno set; ENOBUFS if the buffer is full)
+ */
+ssize_t TPCircularBufferProduceFromFileDescriptor(TPCircularBuffer *buffer, int fileDescriptor, TPCircularBufferLength maxLength);
+
+/*!
+ * Write from the buffer to a file descriptor
+ *
+ *  Calls write once, straight from the bytes at the end of the buffer, and consumes
+ *  the bytes written. Only call this from the consumer thread.
+ *
+ * @param buffer Circular buffer
+ * @param fileDescriptor File descriptor to write to
+ * @param maxLength Maximum number of bytes to write, or 0 for all available
+ * @return Number of bytes written (0 if the buffer is empty), or -1 on error (with errno set)
+ */
+ssize_t TPCircularBufferConsumeToFileDescriptor(TPCircularBuffer *buffer, int fileDescriptor, TPCircularBufferLength maxLength);
+
+/*!
+ * Receive from a socket into the buffer
+ *
+ *  As TPCircularBufferProduceFromFileDescriptor, but with recv and its flags.
+ *
+ * @param buffer Circular buffer
+ * @param socket Socket to receive from
+ * @param maxLength Maximum number of bytes to receive, or 0 for as many as fit
+ * @param flags Flags for recv, e.g. MSG_DONTWAIT
+ * @return Number of bytes received, 0 if the peer has shut down, or -1 on error (with errno set; ENOBUFS if the buffer is full)
+ */
+ssize_t TPCircularBufferProduceFromSocket(TPCircularBuffer *buffer, int socket, TPCircularBufferLength maxLength, int flags);
+
+/*!
+ * Send from the buffer to a socket
+ *
+ *  As TPCircularBufferConsumeToFileDescriptor, but with send and its flags.
+ *
+ * @param buffer Circular buffer
+ * @param socket Socket to send to
+ * @param maxLength Maximum number of bytes to send, or 0 for all available
+ * @param flags Flags for send, e.g. MSG_DONTWAIT or MSG_NOSIGNAL
+ * @return Number of bytes sent (0 if the buffer is empty), or -1 on error (with errno set)
+ */
+ssize_t TPCircularBufferConsumeToSocket(TPCircularBuffer *buffer, int socket, TPCircularBufferLength maxLength, int flags);
+
+#pragma mark - Datagrams
+
+/*!
+ * Receive messages from a socket into records
+ *
+ *  Receives up to maxMessages datagrams, each straight into its own record, waiting
+ *  (unless flags include MSG_DONTWAIT) for the first only. Each record has room for
+ *  maxMessageLength bytes and occupies that much of the buffer until it's released,
+ *  whatever the actual message length; longer messages are truncated. Only call this
+ *  from the producer thread.
+ *
+ * @param buffer Circular buffer
+ * @param socket Datagram socket to receive from
+ * @param maxMessages Maximum number of messages to receive, up to kTPCircularBufferIOMaxMessages
+ * @param maxMessageLength Maximum length of each message
+ * @param flags Flags for recvmmsg or recv, e.g. MSG_DONTWAIT
+ * @return Number of messages received, or -1 on error (with errno set; ENOBUFS if there's no room for a record)
+ */
+int TPCircularBufferProduceMessagesFromSocket(TPCircularBuffer *buffer,
+                                              int socket,
+                                              int maxMessages,
+                                              int32_t maxMessageLength,
+                                              int flags);
+
+/*!
+ * Send records to a socket as messages
+ *
+ *  Sends up to maxMessages records, each as one datagram, straight from the buffer,
+ *  and releases the records sent. The socket must be connected.
+ *  Only call this from the consumer thread.
+ *
+ * @param buffer Circular buffer
+ * @param socket Connected datagram socket to send to
+ * @param maxMessages Maximum number of messages to send, up to kTPCircularBufferIOMaxMessages
+ * @param flags Flags for sendmmsg or send, e.g. MSG_DONTWAIT
+ * @return Number of messages sent (0 if there are no records), or -1 on error (with errno set)
+ */
+int TPCircularBufferConsumeMessagesToSocket(TPCircularBuffer *buffer, int socket, int maxMessages, int flags);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
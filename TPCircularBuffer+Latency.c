@@ -0,0 +1,155 @@
+//
+//  TPCircularBuffer+Latency.c
+//  Circular/Ring buffer implementation
+//
+//  https://github.com/michaeltyson/TPCircularBuffer
+//
+//  Copyright (C) 2012-2013 A Tasty Pixel
+//
+//  This software is provided 'as-is', without any express or implied
+//  warranty.  In no event will the authors be held liable for any damages
+//  arising from the use of this software.
+//
+//  Permission is granted to anyone to use this software for any purpose,
+//  including commercial applications, and to alter it and redistribute it
+//  freely, subject to the following restrictions:
+//
+//  1. The origin of this software must not be misrepresented; you must not
+//     claim that you wrote the original software. If you use this software
+//     in a product, an acknowledgment in the product documentation would be
+//     appreciated but is not required.
+//
+//  2. Altered source versions must be plainly marked as such, and must not be
+//     misrepresented as being the original software.
+//
+//  3. This notice may not be removed or altered from any source distribution.
+//
+
+#if defined(__linux__) && !defined(_GNU_SOURCE)
+#define _GNU_SOURCE // For CLOCK_MONOTONIC
+#endif
+
+#include "TPCircularBuffer+Latency.h"
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <time.h>
+
+#define kSubBuckets (1 << kTPCircularBufferLatencySubBucketBits)
+
+static int bucketForValue(uint64_t value) {
+    if ( value < kSubBuckets ) return (int)value;
+    if ( value >> (kTPCircularBufferLatencyMaxExponent + 1) ) {
+        value = (1ULL << (kTPCircularBufferLatencyMaxExponent + 1)) - 1;
+    }
+    // The top bit picks the power of two, and the next few bits the linear sub-bucket within it
+    int exponent = 63 - __builtin_clzll(value);
+    int shift = exponent - kTPCircularBufferLatencySubBucketBits;
+    int subBucket = (int)(value >> shift) & (kSubBuckets - 1);
+    return ((shift + 1) << kTPCircularBufferLatencySubBucketBits) + subBucket;
+}
+
+bool _TPCircularBufferLatencyInit(TPCircularBufferLatency *latency, int32_t maxMarks, size_t structSize) {
+    assert(maxMarks > 0);
+    
+    if ( structSize != sizeof(TPCircularBufferLatency) ) {
+        fprintf(stderr,
+                "TPCircularBuffer: Header version mismatch. "
+                "Check for old versions of TPCircularBuffer in your project.\n");
+        abort();
+    }
+    
+    if ( !TPCircularBufferInit(&latency->marks, maxMarks * (TPCircularBufferLength)sizeof(TPCircularBufferLatencyMark)) ) {
+        return false;
+    }
+    
+    latency->producedPosition = 0;
+    latency->consumedPosition = 0;
+    atomic_store_explicit(&latency->droppedMarks, 0, memory_order_relaxed);
+    atomic_store_explicit(&latency->maximum, 0, memory_order_relaxed);
+    for ( int i=0; i<kTPCircularBufferLatencyBuckets; i++ ) {
+        atomic_store_explicit(&latency->counts[i], 0, memory_order_relaxed);
+    }
+    return true;
+}
+
+void TPCircularBufferLatencyCleanup(TPCircularBufferLatency *latency) {
+    TPCircularBufferCleanup(&latency->marks);
+    memset(latency, 0, sizeof(TPCircularBufferLatency));
+}
+
+uint64_t _TPCircularBufferLatencyNow(void) {
+#if defined(__APPLE__)
+    return clock_gettime_nsec_np(CLOCK_UPTIME_RAW);
+#else
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (uint64_t)now.tv_sec * 1000000000ULL + (uint64_t)now.tv_nsec;
+#endif
+}
+
+static void addSample(TPCircularBufferLatency *latency, uint64_t value) {
+    // Only the consumer writes the counts, so a plain load and store will do
+    atomic_ullong *count = &latency->counts[bucketForValue(value)];
+    atomic_store_explicit(count, atomic_load_explicit(count, memory_order_relaxed) + 1, memory_order_relaxed);
+    if ( value > atomic_load_explicit(&latency->maximum, memory_order_relaxed) ) {
+        atomic_store_explicit(&latency->maximum, value, memory_order_relaxed);
+    }
+}
+
+void _TPCircularBufferLatencyConsumed(TPCircularBufferLatency *latency) {
+    uint64_t now = 0;
+    TPCircularBufferLength available;
+    const TPCircularBufferLatencyMark *marks;
+    while ( (marks = (const TPCircularBufferLatencyMark *)TPCircularBufferTail(&latency->marks, &available)) ) {
+        TPCircularBufferLength count = available / (TPCircularBufferLength)sizeof(TPCircularBufferLatencyMark);
+        TPCircularBufferLength finished = 0;
+        while ( finished < count && marks[finished].position <= latency->consumedPosition ) {
+            if ( !now ) now = _TPCircularBufferLatencyNow();
+            addSample(latency, now > marks[finished].timestamp ? now - marks[finished].timestamp : 0);
+            finished++;
+        }
+        if ( finished == 0 ) break;
+        TPCircularBufferConsume(&latency->marks, finished * (TPCircularBufferLength)sizeof(TPCircularBufferLatencyMark));
+        if ( finished < count ) break;
+    }
+}
+
+void TPCircularBufferLatencyGetHistogram(const TPCircularBufferLatency *latency, TPCircularBufferLatencyHistogram *histogram) {
+    histogram->total = 0;
+    for ( int i=0; i<kTPCircularBufferLatencyBuckets; i++ ) {
+        histogram->counts[i] = atomic_load_explicit(&latency->counts[i], memory_order_relaxed);
+        histogram->total += histogram->counts[i];
+    }
+    histogram->maximum = atomic_load_explicit(&latency->maximum, memory_order_relaxed);
+    histogram->droppedMarks = atomic_load_explicit(&latency->droppedMarks, memory_order_relaxed);
+}
+
+uint64_t TPCircularBufferLatencyHistogramPercentile(const TPCircularBufferLatencyHistogram *histogram, double percentile) {
+    if ( histogram->total == 0 ) return 0;
+    uint64_t target = (uint64_t)(percentile / 100.0 * (double)histogram->total + 0.5);
+    if ( target < 1 ) target = 1;
+    if ( target > histogram->total ) target = histogram->total;
+    
+    uint64_t seen = 0;
+    for ( int i=0; i<kTPCircularBufferLatencyBuckets; i++ ) {
+        seen += histogram->counts[i];
+        if ( seen >= target ) {
+            uint64_t highest = TPCircularBufferLatencyBucketRange(i, NULL);
+            return highest < histogram->maximum ? highest : histogram->maximum;
+        }
+    }
+    return histogram->maximum;
+}
+
+uint64_t TPCircularBufferLatencyBucketRange(int bucket, uint64_t *lowest) {
+    assert(bucket >= 0 && bucket < kTPCircularBufferLatencyBuckets);
+    if ( bucket < kSubBuckets ) {
+        if ( lowest ) *lowest = (uint64_t)bucket;
+        return (uint64_t)bucket;
+    }
+    int shift = (bucket >> kTPCircularBufferLatencySubBucketBits) - 1;
+    uint64_t first = ((uint64_t)kSubBuckets + (uint64_t)(bucket & (kSubBuckets - 1))) << shift;
+    if ( lowest ) *lowest = first;
+    return first + (1ULL << shift) - 1;
+}
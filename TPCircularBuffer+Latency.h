@@ -0,0 +1,218 @@
+//
+//  TPCircularBuffer+Latency.h
+//  Circular/Ring buffer implementation
+//
+//  https://github.com/michaeltyson/TPCircularBuffer
+//
+//  Measures how long bytes sit in a buffer. Each timed produce records a timestamp
+//  and the position the produced bytes end at; each timed consume frees some bytes,
+//  and for every produce whose bytes are now all consumed, adds the time since that
+//  produce to a histogram. The histogram can be read from any thread.
+//
+//  The marks are kept in a second, small circular buffer, so neither side blocks or
+//  allocates. If that fills up because the consumer has fallen behind, marks are
+//  dropped (and counted), and the bytes they covered are timed from a later produce.
+//
+//  Histogram buckets are logarithmic, HDR-style: each power of two is divided into
+//  16 linear sub-buckets, so a value's bucket is within about 6% of it.
+//
+//  Copyright (C) 2012-2013 A Tasty Pixel
+//
+//  This software is provided 'as-is', without any express or implied
+//  warranty.  In no event will the authors be held liable for any damages
+//  arising from the use of this software.
+//
+//  Permission is granted to anyone to use this software for any purpose,
+//  including commercial applications, and to alter it and redistribute it
+//  freely, subject to the following restrictions:
+//
+//  1. The origin of this software must not be misrepresented; you must not
+//     claim that you wrote the original software. If you use this software
+//     in a product, an acknowledgment in the product documentation would be
+//     appreciated but is not required.
+//
+//  2. Altered source versions must be plainly marked as such, and must not be
+//     misrepresented as being the original software.
+//
+//  3. This notice may not be removed or altered from any source distribution.
+//
+
+#ifndef TPCircularBuffer_Latency_h
+#define TPCircularBuffer_Latency_h
+
+#include "TPCircularBuffer.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define kTPCircularBufferLatencySubBucketBits 4
+#define kTPCircularBufferLatencyMaxExponent   40 // Values are clamped to about 18 minutes
+#define kTPCircularBufferLatencyBuckets \
+    (((kTPCircularBufferLatencyMaxExponent - kTPCircularBufferLatencySubBucketBits + 2) << kTPCircularBufferLatencySubBucketBits))
+
+typedef struct {
+    uint64_t position;                              // Total bytes produced, including this produce
+    uint64_t timestamp;                             // Nanoseconds
+} TPCircularBufferLatencyMark;
+
+typedef struct {
+    TPCircularBuffer  marks;
+    uint64_t          producedPosition;             // Owned by the producer
+    atomic_ullong     droppedMarks;
+    _TPCircularBufferCacheLinePadding(_padding0)
+    uint64_t          consumedPosition;             // Owned by the consumer
+    atomic_ullong     maximum;
+    atomic_ullong     counts[kTPCircularBufferLatencyBuckets];
+} TPCircularBufferLatency;
+
+/*!
+ * A snapshot of the latency histogram
+ */
+typedef struct {
+    uint64_t counts[kTPCircularBufferLatencyBuckets];
+    uint64_t total;                                 // Number of samples
+    uint64_t maximum;                               // Largest sample, in nanoseconds
+    uint64_t droppedMarks;                          // Produces that couldn't be timed
+} TPCircularBufferLatencyHistogram;
+
+/*!
+ * Initialise latency tracking
+ *
+ * @param latency Latency tracker
+ * @param maxMarks Number of timed produces that can be waiting to be consumed at once;
+ *      rounded up to fill whole pages
+ * @return true on success, false if the marks buffer couldn't be allocated
+ */
+#define TPCircularBufferLatencyInit(latency, maxMarks) \
+    _TPCircularBufferLatencyInit(latency, maxMarks, sizeof(*latency))
+bool _TPCircularBufferLatencyInit(TPCircularBufferLatency *latency, int32_t maxMarks, size_t structSize);
+
+/*!
+ * Cleanup latency tracking
+ *
+ *  Releases tracker resources.
+ */
+void TPCircularBufferLatencyCleanup(TPCircularBufferLatency *latency);
+
+/*!
+ * Get the latency histogram
+ *
+ *  Safe to call from any thread while the buffer is in use. Each count is read
+ *  atomically, but samples added during the read may or may not be included.
+ *
+ * @param latency Latency tracker
+ * @param histogram On output, the histogram
+ */
+void TPCircularBufferLatencyGetHistogram(const TPCircularBufferLatency *latency, TPCircularBufferLatencyHistogram *histogram);
+
+/*!
+ * Find a percentile in a histogram
+ *
+ * @param histogram The histogram
+ * @param percentile The percentile, from 0 to 100
+ * @return The highest value in the bucket the percentile falls in, in nanoseconds, or 0 if there are no samples
+ */
+uint64_t TPCircularBufferLatencyHistogramPercentile(const TPCircularBufferLatencyHistogram *histogram, double percentile);
+
+/*!
+ * Get the range of values in a histogram bucket
+ *
+ * @param bucket Bucket index
+ * @param lowest On output, if not NULL, the lowest value in the bucket, in nanoseconds
+ * @return The highest value in the bucket, in nanoseconds
+ */
+uint64_t TPCircularBufferLatencyBucketRange(int bucket, uint64_t *lowest);
+
+#pragma mark - Internal
+
+/*!
+ * Current time in nanoseconds, from a clock that doesn't jump
+ */
+uint64_t _TPCircularBufferLatencyNow(void);
+
+/*!
+ * Record when the next bytes were produced
+ */
+static __inline__ __attribute__((always_inline)) void _TPCircularBufferLatencyMark(TPCircularBufferLatency *latency,
+                                                                                  TPCircularBufferLength amount) {
+    latency->producedPosition += (uint64_t)amount;
+    TPCircularBufferLatencyMark mark = { latency->producedPosition, _TPCircularBufferLatencyNow() };
+    if ( !TPCircularBufferProduceBytes(&latency->marks, &mark, sizeof(mark)) ) {
+        atomic_store_explicit(&latency->droppedMarks,
+                              atomic_load_explicit(&latency->droppedMarks, memory_order_relaxed) + 1,
+                              memory_order_relaxed);
+    }
+}
+
+/*!
+ * Time the produces whose bytes have all been consumed
+ */
+void _TPCircularBufferLatencyConsumed(TPCircularBufferLatency *latency);
+
+#pragma mark - Writing (producing)
+
+/*!
+ * Produce bytes in buffer, and time them
+ *
+ *  As TPCircularBufferProduce, but also records when the bytes were produced.
+ *
+ * @param buffer Circular buffer
+ * @param latency Latency tracker
+ * @param amount Number of bytes to produce
+ * @return Number of bytes ready for reading before the operation
+ */
+static __inline__ __attribute__((always_inline)) TPCircularBufferLength TPCircularBufferProduceTimed(TPCircularBuffer *buffer,
+                                                                                                      TPCircularBufferLatency *latency,
+                                                                                                      TPCircularBufferLength amount) {
+    // Record the mark before producing the bytes, so the consumer always sees it by the time it consumes them
+    _TPCircularBufferLatencyMark(latency, amount);
+    return TPCircularBufferProduce(buffer, amount);
+}
+
+/*!
+ * Helper routine to copy bytes to buffer, and time them
+ *
+ *  As TPCircularBufferProduceBytes, but also records when the bytes were produced.
+ *
+ * @param buffer Circular buffer
+ * @param latency Latency tracker
+ * @param src Source buffer
+ * @param len Number of bytes in source buffer
+ * @return true if bytes copied, false if there was insufficient space
+ */
+static __inline__ __attribute__((always_inline)) bool TPCircularBufferProduceBytesTimed(TPCircularBuffer *buffer,
+                                                                                        TPCircularBufferLatency *latency,
+                                                                                        const void *src,
+                                                                                        TPCircularBufferLength len) {
+    if ( !_TPCircularBufferCopyToHead(buffer, src, len, _TPCircularBufferAtomic(buffer)) ) return false;
+    TPCircularBufferProduceTimed(buffer, latency, len);
+    return true;
+}
+
+#pragma mark - Reading (consuming)
+
+/*!
+ * Consume bytes in buffer, and time them
+ *
+ *  As TPCircularBufferConsume, but also adds the time the bytes spent in the
+ *  buffer to the histogram: one sample for each timed produce whose bytes have
+ *  now all been consumed.
+ *
+ * @param buffer Circular buffer
+ * @param latency Latency tracker
+ * @param amount Number of bytes to consume
+ */
+static __inline__ __attribute__((always_inline)) void TPCircularBufferConsumeTimed(TPCircularBuffer *buffer,
+                                                                                    TPCircularBufferLatency *latency,
+                                                                                    TPCircularBufferLength amount) {
+    TPCircularBufferConsume(buffer, amount);
+    latency->consumedPosition += (uint64_t)amount;
+    _TPCircularBufferLatencyConsumed(latency);
+}
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
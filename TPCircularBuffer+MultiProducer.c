@@ -0,0 +1,153 @@
+//
+//  TPCircularBuffer+MultiProducer.c
+//  Circular/Ring buffer implementation
+//
+//  https://github.com/michaeltyson/TPCircularBuffer
+//
+//  Copyright (C) 2012-2013 A Tasty Pixel
+//
+//  This software is provided 'as-is', without any express or implied
+//  warranty.  In no event will the authors be held liable for any damages
+//  arising from the use of this software.
+//
+//  Permission is granted to anyone to use this software for any purpose,
+//  including commercial applications, and to alter it and redistribute it
+//  freely, subject to the following restrictions:
+//
+//  1. The origin of this software must not be misrepresented; you must not
+//     claim that you wrote the original software. If you use this software
+//     in a product, an acknowledgment in the product documentation would be
+//     appreciated but is not required.
+//
+//  2. Altered source versions must be plainly marked as such, and must not be
+//     misrepresented as being the original software.
+//
+//  3. This notice may not be removed or altered from any source distribution.
+//
+
+#include "TPCircularBuffer+MultiProducer.h"
+
+#include <stdlib.h>
+#include <stdio.h>
+
+static inline uint64_t makeState(uint32_t ticket, uint32_t value) {
+    return ((uint64_t)ticket << 32) | value;
+}
+
+static inline uint32_t stateTicket(uint64_t state) {
+    return (uint32_t)(state >> 32);
+}
+
+static inline uint32_t stateValue(uint64_t state) {
+    return (uint32_t)state;
+}
+
+bool _TPMultiProducerCircularBufferInit(TPMultiProducerCircularBuffer *buffer, int32_t length, size_t structSize) {
+    if ( structSize != sizeof(TPMultiProducerCircularBuffer) ) {
+        fprintf(stderr,
+                "TPCircularBuffer: Header version mismatch. "
+                "Check for old versions of TPCircularBuffer in your project.\n");
+        abort();
+    }
+
+    if ( length > kTPMultiProducerCircularBufferMaxLength ) {
+        fprintf(stderr, "TPCircularBuffer: Length too large for a multi-producer buffer.\n");
+        return false;
+    }
+
+    if ( !TPCircularBufferInit(&buffer->buffer, length) ) {
+        return false;
+    }
+
+    if ( buffer->buffer.length > kTPMultiProducerCircularBufferMaxLength ) {
+        fprintf(stderr, "TPCircularBuffer: Length too large for a multi-producer buffer once rounded up to whole pages.\n");
+        TPCircularBufferCleanup(&buffer->buffer);
+        return false;
+    }
+    assert(buffer->buffer.length <= kTPMultiProducerCircularBufferMaxLength); // Positions run to twice the length
+
+    atomic_store_explicit(&buffer->reserved, 0, memory_order_relaxed);
+    atomic_store_explicit(&buffer->committed, 0, memory_order_relaxed);
+    atomic_store_explicit(&buffer->consumed, 0, memory_order_relaxed);
+    for ( uint32_t i=0; i<kTPMultiProducerCircularBufferMaxReservations; i++ ) {
+        // Tag each entry with a ticket that will never look up this entry
+        atomic_store_explicit(&buffer->commits[i],
+                              makeState(i - kTPMultiProducerCircularBufferMaxReservations, 0),
+                              memory_order_relaxed);
+    }
+    atomic_thread_fence(memory_order_release);
+
+    return true;
+}
+
+void TPMultiProducerCircularBufferCleanup(TPMultiProducerCircularBuffer *buffer) {
+    TPCircularBufferCleanup(&buffer->buffer);
+    memset(buffer, 0, sizeof(TPMultiProducerCircularBuffer));
+}
+
+void *TPMultiProducerCircularBufferReserve(TPMultiProducerCircularBuffer *buffer,
+                                           int32_t length,
+                                           TPMultiProducerCircularBufferReservation *reservation) {
+    assert(length > 0);
+    if ( length > buffer->buffer.length ) return NULL;
+
+    uint64_t reserved = atomic_load_explicit(&buffer->reserved, memory_order_relaxed);
+    while ( true ) {
+        uint32_t ticket = stateTicket(reserved);
+        uint32_t position = stateValue(reserved);
+
+        // Load these after the reservation state, so that if they're stale, they're conservative
+        uint32_t consumed = atomic_load_explicit(&buffer->consumed, memory_order_acquire);
+        uint32_t oldestTicket = stateTicket(atomic_load_explicit(&buffer->committed, memory_order_relaxed));
+
+        int32_t used = _TPMultiProducerCircularBufferDistance(buffer, consumed, position);
+        if ( used > buffer->buffer.length || (int32_t)(ticket - oldestTicket) < 0 ) {
+            // Our view of the reservation state is older than the consumer or commit state; look again
+            reserved = atomic_load_explicit(&buffer->reserved, memory_order_relaxed);
+            continue;
+        }
+
+        if ( used + length > buffer->buffer.length
+                || ticket - oldestTicket >= kTPMultiProducerCircularBufferMaxReservations ) {
+            return NULL;
+        }
+
+        uint64_t next = makeState(ticket + 1, _TPMultiProducerCircularBufferAdvance(buffer, position, length));
+        if ( atomic_compare_exchange_weak_explicit(&buffer->reserved, &reserved, next,
+                                                   memory_order_relaxed, memory_order_relaxed) ) {
+            reservation->ticket = ticket;
+            reservation->length = length;
+            TPCircularBufferLength offset = (TPCircularBufferLength)position;
+            if ( offset >= buffer->buffer.length ) offset -= buffer->buffer.length;
+            return (char *)buffer->buffer.buffer + offset;
+        }
+    }
+}
+
+void TPMultiProducerCircularBufferCommit(TPMultiProducerCircularBuffer *buffer,
+                                         const TPMultiProducerCircularBufferReservation *reservation) {
+    // Record the commit. This and the loads below are sequentially consistent, so that either
+    // we see the committed position reach our ticket, or the producer that moves it there sees this.
+    atomic_store_explicit(&buffer->commits[reservation->ticket % kTPMultiProducerCircularBufferMaxReservations],
+                          makeState(reservation->ticket, (uint32_t)reservation->length),
+                          memory_order_seq_cst);
+
+    // Advance the committed position past every consecutive committed reservation
+    uint64_t committed = atomic_load_explicit(&buffer->committed, memory_order_seq_cst);
+    while ( true ) {
+        uint32_t ticket = stateTicket(committed);
+        uint64_t commit = atomic_load_explicit(&buffer->commits[ticket % kTPMultiProducerCircularBufferMaxReservations],
+                                               memory_order_seq_cst);
+        if ( stateTicket(commit) != ticket ) {
+            // The oldest outstanding reservation isn't committed yet; its producer will continue from here
+            break;
+        }
+
+        uint64_t next = makeState(ticket + 1,
+                                  _TPMultiProducerCircularBufferAdvance(buffer, stateValue(committed), (int32_t)stateValue(commit)));
+        if ( atomic_compare_exchange_weak_explicit(&buffer->committed, &committed, next,
+                                                   memory_order_seq_cst, memory_order_seq_cst) ) {
+            committed = next;
+        }
+    }
+}
@@ -0,0 +1,222 @@
+//
+//  TPCircularBuffer+MultiProducer.h
+//  Circular/Ring buffer implementation
+//
+//  https://github.com/michaeltyson/TPCircularBuffer
+//
+//  A variant of TPCircularBuffer that is safe for any number of producers and a single
+//  consumer. Producers reserve contiguous regions of the mirrored buffer concurrently,
+//  fill them, and commit them in any order; the consumer only ever sees the committed
+//  bytes, in reservation order.
+//
+//  Each reservation takes a ticket, and commits are recorded in a small table indexed by
+//  ticket. Whichever producer completes the oldest outstanding reservation advances the
+//  committed position past every consecutive completed reservation, so no producer waits
+//  on another.
+//
+//  Copyright (C) 2012-2013 A Tasty Pixel
+//
+//  This software is provided 'as-is', without any express or implied
+//  warranty.  In no event will the authors be held liable for any damages
+//  arising from the use of this software.
+//
+//  Permission is granted to anyone to use this software for any purpose,
+//  including commercial applications, and to alter it and redistribute it
+//  freely, subject to the following restrictions:
+//
+//  1. The origin of this software must not be misrepresented; you must not
+//     claim that you wrote the original software. If you use this software
+//     in a product, an acknowledgment in the product documentation would be
+//     appreciated but is not required.
+//
+//  2. Altered source versions must be plainly marked as such, and must not be
+//     misrepresented as being the original software.
+//
+//  3. This notice may not be removed or altered from any source distribution.
+//
+
+#ifndef TPCircularBuffer_MultiProducer_h
+#define TPCircularBuffer_MultiProducer_h
+
+#include "TPCircularBuffer.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*!
+ * Maximum number of reservations that may be outstanding at once
+ *
+ *  Reservations beyond this fail until the oldest outstanding one is committed.
+ */
+#define kTPMultiProducerCircularBufferMaxReservations 256
+
+/*!
+ * Largest buffer length, after rounding up to whole pages
+ *
+ *  Positions run to twice the length, and must fit in 32 bits.
+ */
+#define kTPMultiProducerCircularBufferMaxLength (INT32_MAX / 2)
+
+typedef struct {
+    TPCircularBuffer  buffer;
+    _TPCircularBufferCacheLinePadding(_padding0)
+    atomic_ullong     reserved;                     // Next ticket (high 32 bits) and position (low 32 bits)
+    _TPCircularBufferCacheLinePadding(_padding1)
+    atomic_ullong     committed;                    // Oldest uncommitted ticket and committed position
+    _TPCircularBufferCacheLinePadding(_padding2)
+    atomic_uint       consumed;                     // Consumed position
+    _TPCircularBufferCacheLinePadding(_padding3)
+    atomic_ullong     commits[kTPMultiProducerCircularBufferMaxReservations]; // Ticket and length, once committed
+} TPMultiProducerCircularBuffer;
+
+/*!
+ * A region reserved by a producer
+ */
+typedef struct {
+    uint32_t ticket;
+    int32_t  length;
+} TPMultiProducerCircularBufferReservation;
+
+/*!
+ * Initialise buffer
+ *
+ *  As with TPCircularBufferInit, the length will be rounded up to a multiple of
+ *  the device page size. Positions are packed with a ticket into 64 bits, so the
+ *  rounded length may be at most kTPMultiProducerCircularBufferMaxLength, just under
+ *  1 GiB, even with TPCIRCULARBUFFER_64BIT_LENGTHS.
+ *
+ * @param buffer Circular buffer
+ * @param length Length of buffer
+ * @return true on success, false if the length is too large or the buffer couldn't be created
+ */
+#define TPMultiProducerCircularBufferInit(buffer, length) \
+    _TPMultiProducerCircularBufferInit(buffer, length, sizeof(*buffer))
+bool _TPMultiProducerCircularBufferInit(TPMultiProducerCircularBuffer *buffer, int32_t length, size_t structSize);
+
+/*!
+ * Cleanup buffer
+ *
+ *  Releases buffer resources.
+ */
+void TPMultiProducerCircularBufferCleanup(TPMultiProducerCircularBuffer *buffer);
+
+#pragma mark - Internal
+
+/*!
+ * Positions run from 0 to twice the buffer length, so that a full buffer can be
+ * distinguished from an empty one without any division
+ */
+static __inline__ __attribute__((always_inline)) uint32_t _TPMultiProducerCircularBufferAdvance(const TPMultiProducerCircularBuffer *buffer,
+                                                                                                uint32_t position,
+                                                                                                int32_t amount) {
+    uint32_t wrap = 2 * (uint32_t)buffer->buffer.length;
+    position += (uint32_t)amount;
+    return position >= wrap ? position - wrap : position;
+}
+
+static __inline__ __attribute__((always_inline)) int32_t _TPMultiProducerCircularBufferDistance(const TPMultiProducerCircularBuffer *buffer,
+                                                                                                uint32_t from,
+                                                                                                uint32_t to) {
+    int32_t distance = (int32_t)(to - from);
+    return distance < 0 ? (int32_t)(distance + 2 * buffer->buffer.length) : distance;
+}
+
+#pragma mark - Writing (producing)
+
+/*!
+ * Reserve space for writing
+ *
+ *  Reserves a contiguous region of the given length, which the caller must fill and
+ *  then pass to TPMultiProducerCircularBufferCommit. Safe for use by any number of
+ *  producers at once.
+ *
+ * @param buffer Circular buffer
+ * @param length Number of bytes to reserve
+ * @param reservation On output, the reservation to pass to TPMultiProducerCircularBufferCommit
+ * @return Pointer to the reserved region, or NULL if there's insufficient space or too many outstanding reservations
+ */
+void *TPMultiProducerCircularBufferReserve(TPMultiProducerCircularBuffer *buffer,
+                                           int32_t length,
+                                           TPMultiProducerCircularBufferReservation *reservation);
+
+/*!
+ * Commit a reserved region
+ *
+ *  Marks the reserved region ready for reading. Regions may be committed in any order,
+ *  but the consumer only sees a region once all regions reserved before it have been
+ *  committed too.
+ *
+ * @param buffer Circular buffer
+ * @param reservation The reservation returned from TPMultiProducerCircularBufferReserve
+ */
+void TPMultiProducerCircularBufferCommit(TPMultiProducerCircularBuffer *buffer,
+                                         const TPMultiProducerCircularBufferReservation *reservation);
+
+/*!
+ * Helper routine to copy bytes to buffer
+ *
+ *  This reserves space for the given bytes, copies them, and commits them.
+ *
+ * @param buffer Circular buffer
+ * @param src Source buffer
+ * @param len Number of bytes in source buffer
+ * @return true if bytes copied, false if there was insufficient space
+ */
+static __inline__ __attribute__((always_inline)) bool TPMultiProducerCircularBufferProduceBytes(TPMultiProducerCircularBuffer *buffer,
+                                                                                               const void *src,
+                                                                                               int32_t len) {
+    TPMultiProducerCircularBufferReservation reservation;
+    void *ptr = TPMultiProducerCircularBufferReserve(buffer, len, &reservation);
+    if ( !ptr ) return false;
+    _TPCircularBufferCopyIn(ptr, src, len);
+    TPMultiProducerCircularBufferCommit(buffer, &reservation);
+    return true;
+}
+
+#pragma mark - Reading (consuming)
+
+/*!
+ * Access end of buffer
+ *
+ *  This gives you a pointer to the end of the buffer, ready for reading, and the
+ *  number of committed bytes available to read. Only one consumer may use the buffer.
+ *
+ * @param buffer Circular buffer
+ * @param availableBytes On output, the number of bytes ready for reading
+ * @return Pointer to the first bytes ready for reading, or NULL if buffer is empty
+ */
+static __inline__ __attribute__((always_inline)) void *TPMultiProducerCircularBufferTail(TPMultiProducerCircularBuffer *buffer,
+                                                                                        int32_t *availableBytes) {
+    uint32_t committed = (uint32_t)atomic_load_explicit(&buffer->committed, memory_order_acquire);
+    uint32_t consumed = atomic_load_explicit(&buffer->consumed, memory_order_relaxed);
+    *availableBytes = _TPMultiProducerCircularBufferDistance(buffer, consumed, committed);
+
+    if ( *availableBytes == 0 ) return NULL;
+    return (void *)((char *)buffer->buffer.buffer + buffer->buffer.tail);
+}
+
+/*!
+ * Consume bytes in buffer
+ *
+ *  This frees up the just-read bytes, ready for reserving again.
+ *
+ * @param buffer Circular buffer
+ * @param amount Number of bytes to consume
+ */
+static __inline__ __attribute__((always_inline)) void TPMultiProducerCircularBufferConsume(TPMultiProducerCircularBuffer *buffer,
+                                                                                          int32_t amount) {
+    assert(amount <= buffer->buffer.length);
+    TPCircularBufferLength untilEnd = buffer->buffer.length - buffer->buffer.tail;
+    buffer->buffer.tail = amount >= untilEnd ? amount - untilEnd : buffer->buffer.tail + amount;
+    uint32_t consumed = atomic_load_explicit(&buffer->consumed, memory_order_relaxed);
+    atomic_store_explicit(&buffer->consumed,
+                          _TPMultiProducerCircularBufferAdvance(buffer, consumed, amount),
+                          memory_order_release);
+}
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -0,0 +1,80 @@
+//
+//  TPCircularBuffer+Overwrite.c
+//  Circular/Ring buffer implementation
+//
+//  https://github.com/michaeltyson/TPCircularBuffer
+//
+//  Copyright (C) 2012-2013 A Tasty Pixel
+//
+//  This software is provided 'as-is', without any express or implied
+//  warranty.  In no event will the authors be held liable for any damages
+//  arising from the use of this software.
+//
+//  Permission is granted to anyone to use this software for any purpose,
+//  including commercial applications, and to alter it and redistribute it
+//  freely, subject to the following restrictions:
+//
+//  1. The origin of this software must not be misrepresented; you must not
+//     claim that you wrote the original software. If you use this software
+//     in a product, an acknowledgment in the product documentation would be
+//     appreciated but is not required.
+//
+//  2. Altered source versions must be plainly marked as such, and must not be
+//     misrepresented as being the original software.
+//
+//  3. This notice may not be removed or altered from any source distribution.
+//
+
+#include "TPCircularBuffer.h"
+
+#if TPCIRCULARBUFFER_CACHED_INDICES
+
+#include "TPCircularBuffer+Overwrite.h"
+
+TPCircularBufferLength TPCircularBufferConsumeBytesOverwriting(TPCircularBuffer *buffer, void *dst, TPCircularBufferLength len, TPCircularBufferLength *lostBytes) {
+    _TPCircularBufferPosition lost = 0;
+    _TPCircularBufferPosition tailPosition = atomic_load_explicit(&buffer->tailPosition, memory_order_acquire);
+    TPCircularBufferLength amount = 0;
+    
+    while ( true ) {
+        // Catch up with anything the producer discarded since we last looked
+        _TPCircularBufferPosition discarded = tailPosition - buffer->lastTailPosition;
+        if ( discarded > 0 ) {
+            lost += discarded;
+            TPCircularBufferLength skip = (TPCircularBufferLength)(discarded % (_TPCircularBufferPosition)buffer->length);
+            TPCircularBufferLength untilEnd = buffer->length - buffer->tail;
+            buffer->tail = skip >= untilEnd ? skip - untilEnd : buffer->tail + skip;
+            buffer->lastTailPosition = tailPosition;
+        }
+        
+        buffer->cachedHeadPosition = atomic_load_explicit(&buffer->headPosition, memory_order_acquire);
+        TPCircularBufferLength fillCount = (TPCircularBufferLength)(buffer->cachedHeadPosition - tailPosition);
+        amount = fillCount < len ? fillCount : len;
+        if ( amount <= 0 ) {
+            amount = 0;
+            _TPCircularBufferStatsEmpty(buffer);
+            break;
+        }
+        
+        if ( dst ) {
+            _TPCircularBufferCopyOut(dst, (char *)buffer->buffer + buffer->tail, amount);
+        }
+        
+        // Claim the bytes we copied. This fails if the producer discarded any of them meanwhile,
+        // in which case the copy may be torn: tailPosition is updated, and we try again.
+        if ( atomic_compare_exchange_strong_explicit(&buffer->tailPosition, &tailPosition, tailPosition + (_TPCircularBufferPosition)amount,
+                                                     memory_order_acq_rel, memory_order_acquire) ) {
+            TPCircularBufferLength untilEnd = buffer->length - buffer->tail;
+            buffer->tail = amount >= untilEnd ? amount - untilEnd : buffer->tail + amount;
+            buffer->lastTailPosition = tailPosition + (_TPCircularBufferPosition)amount;
+            _TPCircularBufferStatsConsumed(buffer, amount);
+            break;
+        }
+    }
+    
+    if ( lost > 0 ) _TPCircularBufferStatsLost(buffer, (uint64_t)lost);
+    if ( lostBytes ) *lostBytes = (TPCircularBufferLength)lost;
+    return amount;
+}
+
+#endif
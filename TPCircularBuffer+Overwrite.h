@@ -0,0 +1,140 @@
+//
+//  TPCircularBuffer+Overwrite.h
+//  Circular/Ring buffer implementation
+//
+//  https://github.com/michaeltyson/TPCircularBuffer
+//
+//  Overwrite mode, in which the producer never waits for the consumer: when the buffer
+//  is full, the oldest bytes are discarded to make room, and the consumer is told how
+//  many bytes it lost. This suits monitoring taps, where a stalled consumer must never
+//  hold up the producer.
+//
+//  The producer discards bytes by atomically advancing the consumer's position. The
+//  consumer therefore copies bytes out and then claims them with a compare-and-swap on
+//  the same position, which fails if the producer discarded them in the meantime, so
+//  the consumer never returns bytes that were overwritten while it was reading them.
+//
+//  In overwrite mode, the consumer must use TPCircularBufferConsumeBytesOverwriting in
+//  place of TPCircularBufferTail, TPCircularBufferConsume and TPCircularBufferClear.
+//  The producer may use TPCircularBufferProduce as usual, after
+//  TPCircularBufferHeadOverwriting. This requires TPCIRCULARBUFFER_CACHED_INDICES;
+//  without it, this header declares nothing.
+//
+//  Copyright (C) 2012-2013 A Tasty Pixel
+//
+//  This software is provided 'as-is', without any express or implied
+//  warranty.  In no event will the authors be held liable for any damages
+//  arising from the use of this software.
+//
+//  Permission is granted to anyone to use this software for any purpose,
+//  including commercial applications, and to alter it and redistribute it
+//  freely, subject to the following restrictions:
+//
+//  1. The origin of this software must not be misrepresented; you must not
+//     claim that you wrote the original software. If you use this software
+//     in a product, an acknowledgment in the product documentation would be
+//     appreciated but is not required.
+//
+//  2. Altered source versions must be plainly marked as such, and must not be
+//     misrepresented as being the original software.
+//
+//  3. This notice may not be removed or altered from any source distribution.
+//
+
+#ifndef TPCircularBuffer_Overwrite_h
+#define TPCircularBuffer_Overwrite_h
+
+#include "TPCircularBuffer.h"
+
+#if TPCIRCULARBUFFER_CACHED_INDICES
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#pragma mark - Writing (producing)
+
+/*!
+ * Access front of buffer, discarding the oldest bytes if necessary
+ *
+ *  This gives you a pointer to the front of the buffer, with room for at least the
+ *  given number of bytes. If there's not enough free space, the oldest unread bytes
+ *  are discarded to make room. Follow with TPCircularBufferProduce as usual.
+ *
+ * @param buffer Circular buffer
+ * @param length Number of bytes required, no more than the buffer length
+ * @param discardedBytes On output, if not NULL, the number of unread bytes discarded
+ * @return Pointer to the first bytes ready for writing
+ */
+static __inline__ __attribute__((always_inline)) void *TPCircularBufferHeadOverwriting(TPCircularBuffer *buffer,
+                                                                                       TPCircularBufferLength length,
+                                                                                       TPCircularBufferLength *discardedBytes) {
+    assert(length <= buffer->length);
+    _TPCircularBufferPosition headPosition = atomic_load_explicit(&buffer->headPosition, memory_order_relaxed);
+    _TPCircularBufferPosition tailPosition = buffer->cachedTailPosition;
+    TPCircularBufferLength discarded = 0;
+    
+    if ( (TPCircularBufferLength)(headPosition - tailPosition) + length > buffer->length ) {
+        tailPosition = atomic_load_explicit(&buffer->tailPosition, memory_order_acquire);
+        while ( true ) {
+            TPCircularBufferLength excess = (TPCircularBufferLength)(headPosition - tailPosition) + length - buffer->length;
+            if ( excess <= 0 ) break;
+            // Claim the oldest bytes from the consumer. On failure, tailPosition holds the
+            // consumer's new position, and we may no longer need to discard as much.
+            if ( atomic_compare_exchange_weak_explicit(&buffer->tailPosition, &tailPosition, tailPosition + (_TPCircularBufferPosition)excess,
+                                                       memory_order_acq_rel, memory_order_acquire) ) {
+                tailPosition += (_TPCircularBufferPosition)excess;
+                discarded = excess;
+                break;
+            }
+        }
+        buffer->cachedTailPosition = tailPosition;
+    }
+    
+    if ( discardedBytes ) *discardedBytes = discarded;
+    return (void *)((char *)buffer->buffer + buffer->head);
+}
+
+/*!
+ * Helper routine to copy bytes to buffer, discarding the oldest bytes if necessary
+ *
+ * @param buffer Circular buffer
+ * @param src Source buffer
+ * @param len Number of bytes in source buffer, no more than the buffer length
+ * @return The number of unread bytes discarded to make room
+ */
+static __inline__ __attribute__((always_inline)) TPCircularBufferLength TPCircularBufferProduceBytesOverwriting(TPCircularBuffer *buffer,
+                                                                                                                const void *src,
+                                                                                                                TPCircularBufferLength len) {
+    TPCircularBufferLength discarded;
+    void *ptr = TPCircularBufferHeadOverwriting(buffer, len, &discarded);
+    _TPCircularBufferCopyIn(ptr, src, len);
+    TPCircularBufferProduce(buffer, len);
+    return discarded;
+}
+
+#pragma mark - Reading (consuming)
+
+/*!
+ * Copy bytes out of the buffer and consume them
+ *
+ *  Copies up to the given number of bytes from the end of the buffer, and consumes
+ *  them. Bytes the producer discards while they're being copied are never returned;
+ *  they're reported as lost instead, and counted in the bytesLost statistic with
+ *  TPCIRCULARBUFFER_STATS.
+ *
+ * @param buffer Circular buffer
+ * @param dst Destination buffer, or NULL to consume without copying
+ * @param len Maximum number of bytes to copy
+ * @param lostBytes On output, if not NULL, the number of bytes discarded by the producer since the last call
+ * @return The number of bytes copied
+ */
+TPCircularBufferLength TPCircularBufferConsumeBytesOverwriting(TPCircularBuffer *buffer, void *dst, TPCircularBufferLength len, TPCircularBufferLength *lostBytes);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
+
+#endif
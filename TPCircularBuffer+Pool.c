@@ -0,0 +1,192 @@
+//
+//  TPCircularBuffer+Pool.c
+//  Circular/Ring buffer implementation
+//
+//  https://github.com/michaeltyson/TPCircularBuffer
+//
+//  Copyright (C) 2012-2013 A Tasty Pixel
+//
+//  This software is provided 'as-is', without any express or implied
+//  warranty.  In no event will the authors be held liable for any damages
+//  arising from the use of this software.
+//
+//  Permission is granted to anyone to use this software for any purpose,
+//  including commercial applications, and to alter it and redistribute it
+//  freely, subject to the following restrictions:
+//
+//  1. The origin of this software must not be misrepresented; you must not
+//     claim that you wrote the original software. If you use this software
+//     in a product, an acknowledgment in the product documentation would be
+//     appreciated but is not required.
+//
+//  2. Altered source versions must be plainly marked as such, and must not be
+//     misrepresented as being the original software.
+//
+//  3. This notice may not be removed or altered from any source distribution.
+//
+
+#include "TPCircularBuffer+Pool.h"
+
+#include <stdlib.h>
+#include <unistd.h>
+#include <pthread.h>
+
+#define kSizeClasses 32
+
+/*!
+ * An idle buffer, stored in the buffer's own memory
+ */
+typedef struct TPCircularBufferPoolEntry {
+    struct TPCircularBufferPoolEntry *next;
+} TPCircularBufferPoolEntry;
+
+typedef struct {
+    pthread_mutex_t            mutex;
+    TPCircularBufferPoolEntry *entries;
+    int                        count;
+} TPCircularBufferPoolSizeClass;
+
+struct TPCircularBufferPool {
+    int32_t                       pageSize;
+    int                           maxBuffersPerClass;
+    TPCircularBufferPoolSizeClass classes[kSizeClasses];
+};
+
+/*!
+ * Find the size class for a length: class n holds buffers of 2^n pages
+ *
+ * @return The size class, or -1 if the length is too large
+ */
+static int sizeClass(const TPCircularBufferPool *pool, TPCircularBufferLength length) {
+    int index = 0;
+    int64_t classLength = pool->pageSize;
+    while ( classLength < length && index < kSizeClasses ) {
+        classLength *= 2;
+        index++;
+    }
+    return index >= kSizeClasses || classLength > kTPCircularBufferMaxLength ? -1 : index;
+}
+
+static TPCircularBufferLength sizeClassLength(const TPCircularBufferPool *pool, int index) {
+    return (TPCircularBufferLength)pool->pageSize << index;
+}
+
+TPCircularBufferPool *TPCircularBufferPoolCreate(int maxBuffersPerClass) {
+    TPCircularBufferPool *pool = (TPCircularBufferPool *)calloc(1, sizeof(TPCircularBufferPool));
+    if ( !pool ) return NULL;
+    pool->pageSize = (int32_t)sysconf(_SC_PAGESIZE);
+    pool->maxBuffersPerClass = maxBuffersPerClass;
+    for ( int i=0; i<kSizeClasses; i++ ) {
+        pthread_mutex_init(&pool->classes[i].mutex, NULL);
+    }
+    return pool;
+}
+
+void TPCircularBufferPoolDestroy(TPCircularBufferPool *pool) {
+    for ( int i=0; i<kSizeClasses; i++ ) {
+        TPCircularBufferPoolEntry *entry = pool->classes[i].entries;
+        while ( entry ) {
+            TPCircularBufferPoolEntry *next = entry->next;
+            TPCircularBuffer buffer;
+            buffer.buffer = entry;
+            buffer.length = sizeClassLength(pool, i);
+            TPCircularBufferCleanup(&buffer);
+            entry = next;
+        }
+        pthread_mutex_destroy(&pool->classes[i].mutex);
+    }
+    free(pool);
+}
+
+bool TPCircularBufferPoolReserve(TPCircularBufferPool *pool, TPCircularBufferLength length, int count) {
+    int index = sizeClass(pool, length);
+    if ( index < 0 ) return false;
+    TPCircularBufferPoolSizeClass *bucket = &pool->classes[index];
+    if ( count > pool->maxBuffersPerClass ) count = pool->maxBuffersPerClass;
+
+    while ( true ) {
+        pthread_mutex_lock(&bucket->mutex);
+        bool full = bucket->count >= count;
+        pthread_mutex_unlock(&bucket->mutex);
+        if ( full ) return true;
+
+        // Create the buffer outside the lock, so it doesn't hold up other threads
+        TPCircularBuffer buffer;
+        if ( !TPCircularBufferInit(&buffer, sizeClassLength(pool, index)) ) {
+            return false;
+        }
+        TPCircularBufferPoolCleanup(pool, &buffer);
+    }
+}
+
+bool TPCircularBufferPoolInit(TPCircularBufferPool *pool, TPCircularBuffer *buffer, TPCircularBufferLength length) {
+    return TPCircularBufferPoolInitWithOptions(pool, buffer, length, 0);
+}
+
+bool TPCircularBufferPoolInitWithOptions(TPCircularBufferPool *pool,
+                                         TPCircularBuffer *buffer,
+                                         TPCircularBufferLength length,
+                                         TPCircularBufferOptions options) {
+    assert(length > 0);
+    if ( options & (kTPCircularBufferOptionHugePages | _kTPCircularBufferOptionNUMANode) ) {
+        // Pooled buffers use normal pages, and may already have pages placed on any node
+        return TPCircularBufferInitWithOptions(buffer, length, options);
+    }
+    int index = sizeClass(pool, length);
+    if ( index < 0 ) return false;
+    TPCircularBufferPoolSizeClass *bucket = &pool->classes[index];
+
+    pthread_mutex_lock(&bucket->mutex);
+    TPCircularBufferPoolEntry *entry = bucket->entries;
+    if ( entry ) {
+        bucket->entries = entry->next;
+        bucket->count--;
+    }
+    pthread_mutex_unlock(&bucket->mutex);
+
+    if ( !entry ) {
+        return TPCircularBufferInitWithOptions(buffer, sizeClassLength(pool, index), options);
+    }
+
+    buffer->buffer = entry;
+    buffer->length = sizeClassLength(pool, index);
+    buffer->pageSize = pool->pageSize;
+
+    // Clear the free list link; the rest of the buffer keeps whatever the previous owner left
+    memset(entry, 0, sizeof(TPCircularBufferPoolEntry));
+    if ( !_TPCircularBufferApplyOptions(buffer, options) ) {
+        TPCircularBufferPoolCleanup(pool, buffer);
+        return false;
+    }
+    _TPCircularBufferInitState(buffer);
+    return true;
+}
+
+void TPCircularBufferPoolCleanup(TPCircularBufferPool *pool, TPCircularBuffer *buffer) {
+    int index = sizeClass(pool, buffer->length);
+    if ( index < 0 || buffer->length != sizeClassLength(pool, index) || buffer->pageSize != pool->pageSize ) {
+        // Not a size we pool, e.g. created with huge pages
+        TPCircularBufferCleanup(buffer);
+        return;
+    }
+    TPCircularBufferPoolSizeClass *bucket = &pool->classes[index];
+    TPCircularBufferPoolEntry *entry = (TPCircularBufferPoolEntry *)buffer->buffer;
+
+    // Drop any locking or NUMA binding before another thread can take the buffer
+    if ( buffer->appliedOptions ) _TPCircularBufferResetOptions(buffer);
+
+    pthread_mutex_lock(&bucket->mutex);
+    bool keep = bucket->count < pool->maxBuffersPerClass;
+    if ( keep ) {
+        entry->next = bucket->entries;
+        bucket->entries = entry;
+        bucket->count++;
+    }
+    pthread_mutex_unlock(&bucket->mutex);
+
+    if ( keep ) {
+        memset(buffer, 0, sizeof(TPCircularBuffer));
+    } else {
+        TPCircularBufferCleanup(buffer);
+    }
+}
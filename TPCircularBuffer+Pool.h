@@ -0,0 +1,127 @@
+//
+//  TPCircularBuffer+Pool.h
+//  Circular/Ring buffer implementation
+//
+//  https://github.com/michaeltyson/TPCircularBuffer
+//
+//  A pool of ready-made buffers, to make creating and destroying buffers cheap. Setting
+//  up a buffer's mirrored mapping takes several system calls, which serialise on the
+//  kernel's memory map lock; a pool does that ahead of time, and afterwards only hands
+//  out and takes back mappings, with no system calls.
+//
+//  Buffers are pooled by size class: each class holds buffers of a power-of-two number
+//  of pages, and requested lengths are rounded up to the next class.
+//
+//  Copyright (C) 2012-2013 A Tasty Pixel
+//
+//  This software is provided 'as-is', without any express or implied
+//  warranty.  In no event will the authors be held liable for any damages
+//  arising from the use of this software.
+//
+//  Permission is granted to anyone to use this software for any purpose,
+//  including commercial applications, and to alter it and redistribute it
+//  freely, subject to the following restrictions:
+//
+//  1. The origin of this software must not be misrepresented; you must not
+//     claim that you wrote the original software. If you use this software
+//     in a product, an acknowledgment in the product documentation would be
+//     appreciated but is not required.
+//
+//  2. Altered source versions must be plainly marked as such, and must not be
+//     misrepresented as being the original software.
+//
+//  3. This notice may not be removed or altered from any source distribution.
+//
+
+#ifndef TPCircularBuffer_Pool_h
+#define TPCircularBuffer_Pool_h
+
+#include "TPCircularBuffer.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef struct TPCircularBufferPool TPCircularBufferPool;
+
+/*!
+ * Create a pool
+ *
+ * @param maxBuffersPerClass Maximum number of idle buffers to keep in each size class
+ * @return The pool, or NULL on error
+ */
+TPCircularBufferPool *TPCircularBufferPoolCreate(int maxBuffersPerClass);
+
+/*!
+ * Destroy a pool
+ *
+ *  Releases the pool's idle buffers. Buffers taken from the pool and not yet
+ *  returned may still be cleaned up with TPCircularBufferCleanup.
+ *
+ * @param pool The pool
+ */
+void TPCircularBufferPoolDestroy(TPCircularBufferPool *pool);
+
+/*!
+ * Fill a size class ahead of time
+ *
+ *  Creates idle buffers in the size class for the given length, until it has
+ *  the given number, or the pool's maximum.
+ *
+ * @param pool The pool
+ * @param length Length of buffer
+ * @param count Number of idle buffers wanted
+ * @return true on success, false if a buffer couldn't be created
+ */
+bool TPCircularBufferPoolReserve(TPCircularBufferPool *pool, TPCircularBufferLength length, int count);
+
+/*!
+ * Initialise buffer from the pool
+ *
+ *  Like TPCircularBufferInit, but takes an idle buffer from the pool if there is
+ *  one, and otherwise creates one. The length is rounded up to the size class,
+ *  a power-of-two number of pages. A reused buffer isn't cleared, so unlike a new
+ *  one, it may still hold bytes from its previous owner. Safe to call from any thread.
+ *
+ * @param pool The pool
+ * @param buffer Circular buffer
+ * @param length Length of buffer
+ * @return true on success, false if a buffer couldn't be created
+ */
+bool TPCircularBufferPoolInit(TPCircularBufferPool *pool, TPCircularBuffer *buffer, TPCircularBufferLength length);
+
+/*!
+ * Initialise buffer from the pool, with options
+ *
+ *  As TPCircularBufferPoolInit, with the given combination of kTPCircularBufferOption
+ *  values, which are applied afresh to a reused buffer. Buffers with huge pages or a
+ *  NUMA node are always created new, as the pool can't guarantee either.
+ *
+ * @param pool The pool
+ * @param buffer Circular buffer
+ * @param length Length of buffer
+ * @param options Initialisation options
+ * @return true on success, false if a buffer couldn't be created, bound or locked
+ */
+bool TPCircularBufferPoolInitWithOptions(TPCircularBufferPool *pool,
+                                         TPCircularBuffer *buffer,
+                                         TPCircularBufferLength length,
+                                         TPCircularBufferOptions options);
+
+/*!
+ * Return a buffer to the pool
+ *
+ *  Like TPCircularBufferCleanup, but keeps the buffer's memory for reuse unless
+ *  its size class is full. Any memory locking or NUMA binding is undone, though
+ *  pages already on a node stay there. Safe to call from any thread.
+ *
+ * @param pool The pool
+ * @param buffer Circular buffer
+ */
+void TPCircularBufferPoolCleanup(TPCircularBufferPool *pool, TPCircularBuffer *buffer);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -0,0 +1,284 @@
+//
+//  TPCircularBuffer+Records.h
+//  Circular/Ring buffer implementation
+//
+//  https://github.com/michaeltyson/TPCircularBuffer
+//
+//  Variable-length records on top of the byte buffer. Each record is an aligned header
+//  giving its length, followed by its bytes, padded so the next header is aligned too.
+//  Thanks to the mirrored mapping, every record is contiguous in memory, however it
+//  falls across the end of the buffer.
+//
+//  Producers reserve a record, fill it in place, and commit it; consumers peek at the
+//  next record and release it once done. To take every available record in one pass,
+//  use a read batch with TPCircularBufferBatchNextRecord, which walks the records
+//  within a single snapshot of the buffer and frees them all with a single update.
+//  TPMultiProducerCircularBuffer has the same operations, for multiple producers.
+//
+//  Copyright (C) 2012-2013 A Tasty Pixel
+//
+//  This software is provided 'as-is', without any express or implied
+//  warranty.  In no event will the authors be held liable for any damages
+//  arising from the use of this software.
+//
+//  Permission is granted to anyone to use this software for any purpose,
+//  including commercial applications, and to alter it and redistribute it
+//  freely, subject to the following restrictions:
+//
+//  1. The origin of this software must not be misrepresented; you must not
+//     claim that you wrote the original software. If you use this software
+//     in a product, an acknowledgment in the product documentation would be
+//     appreciated but is not required.
+//
+//  2. Altered source versions must be plainly marked as such, and must not be
+//     misrepresented as being the original software.
+//
+//  3. This notice may not be removed or altered from any source distribution.
+//
+
+#ifndef TPCircularBuffer_Records_h
+#define TPCircularBuffer_Records_h
+
+#include "TPCircularBuffer.h"
+#include "TPCircularBuffer+MultiProducer.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*!
+ * Record alignment
+ *
+ *  Record headers and payloads start on multiples of this many bytes, which must be a
+ *  power of two of at least 8. Define it to 16 or more if payloads hold vector types.
+ *  Producers and consumers must agree on it.
+ */
+#ifndef TPCIRCULARBUFFER_RECORD_ALIGNMENT
+    #define TPCIRCULARBUFFER_RECORD_ALIGNMENT 8
+#endif
+
+typedef struct {
+    int32_t totalLength;    // Header, payload and padding: the offset to the next record
+    int32_t length;         // Payload
+} TPCircularBufferRecordHeader;
+
+#define _TPCircularBufferRecordAlign(length) \
+    (((length) + (TPCIRCULARBUFFER_RECORD_ALIGNMENT - 1)) & ~(TPCIRCULARBUFFER_RECORD_ALIGNMENT - 1))
+
+/*!
+ * Length of a record header, including the padding before the payload
+ */
+#define kTPCircularBufferRecordHeaderLength \
+    ((int32_t)_TPCircularBufferRecordAlign(sizeof(TPCircularBufferRecordHeader)))
+
+/*!
+ * Space a record of the given payload length takes in the buffer
+ *
+ * @param length Payload length
+ * @return Number of bytes the record occupies, including header and padding
+ */
+static __inline__ __attribute__((always_inline)) int32_t TPCircularBufferRecordTotalLength(int32_t length) {
+    assert(length >= 0);
+    return kTPCircularBufferRecordHeaderLength + _TPCircularBufferRecordAlign(length);
+}
+
+static __inline__ __attribute__((always_inline)) void *_TPCircularBufferInitRecord(void *ptr, int32_t length) {
+    TPCircularBufferRecordHeader *header = (TPCircularBufferRecordHeader *)ptr;
+    header->totalLength = TPCircularBufferRecordTotalLength(length);
+    header->length = length;
+    return (char *)ptr + kTPCircularBufferRecordHeaderLength;
+}
+
+static __inline__ __attribute__((always_inline)) TPCircularBufferRecordHeader *_TPCircularBufferRecordHeader(const void *record) {
+    return (TPCircularBufferRecordHeader *)((char *)record - kTPCircularBufferRecordHeaderLength);
+}
+
+#pragma mark - Writing (producing)
+
+/*!
+ * Reserve a record for writing
+ *
+ *  This gives you a pointer to write the record's payload to, and should be
+ *  followed by TPCircularBufferCommitRecord.
+ *
+ * @param buffer Circular buffer
+ * @param length Payload length
+ * @return Pointer to the payload, or NULL if there's insufficient space
+ */
+static __inline__ __attribute__((always_inline)) void *TPCircularBufferReserveRecord(TPCircularBuffer *buffer,
+                                                                                    int32_t length) {
+    int32_t totalLength = TPCircularBufferRecordTotalLength(length);
+    TPCircularBufferLength space, discard;
+    void *ptr = _TPCircularBufferHead(buffer, &space, &discard, _TPCircularBufferAtomic(buffer));
+#if TPCIRCULARBUFFER_CACHED_INDICES
+    if ( space < totalLength ) {
+        // The cached view of the consumer may be stale; look again before giving up
+        _TPCircularBufferProducerFillCount(buffer, _TPCircularBufferAtomic(buffer), true);
+        ptr = _TPCircularBufferHead(buffer, &space, &discard, _TPCircularBufferAtomic(buffer));
+    }
+#endif
+    if ( space < totalLength ) {
+        _TPCircularBufferStatsFull(buffer);
+        return NULL;
+    }
+    return _TPCircularBufferInitRecord(ptr, length);
+}
+
+/*!
+ * Commit a record
+ *
+ *  Marks the record reserved with TPCircularBufferReserveRecord ready for reading.
+ *
+ * @param buffer Circular buffer
+ * @param record The record's payload, as returned from TPCircularBufferReserveRecord
+ * @param length Number of payload bytes written, which may be less than the length reserved
+ */
+static __inline__ __attribute__((always_inline)) void TPCircularBufferCommitRecord(TPCircularBuffer *buffer,
+                                                                                   void *record,
+                                                                                   int32_t length) {
+    TPCircularBufferRecordHeader *header = _TPCircularBufferRecordHeader(record);
+    assert(length <= header->length);
+    if ( length != header->length ) {
+        _TPCircularBufferInitRecord(header, length);
+    }
+    TPCircularBufferProduce(buffer, header->totalLength);
+}
+
+/*!
+ * Helper routine to copy a record to buffer
+ *
+ * @param buffer Circular buffer
+ * @param src Source payload
+ * @param len Payload length
+ * @return true if the record was copied, false if there was insufficient space
+ */
+static __inline__ __attribute__((always_inline)) bool TPCircularBufferProduceRecord(TPCircularBuffer *buffer,
+                                                                                    const void *src,
+                                                                                    int32_t len) {
+    void *record = TPCircularBufferReserveRecord(buffer, len);
+    if ( !record ) return false;
+    _TPCircularBufferCopyIn(record, src, len);
+    TPCircularBufferCommitRecord(buffer, record, len);
+    return true;
+}
+
+/*!
+ * Reserve a record within a write batch
+ *
+ *  Records reserved this way are committed together by TPCircularBufferCommitWriteBatch.
+ *
+ * @param batch The batch
+ * @param length Payload length
+ * @return Pointer to the payload, or NULL if there's insufficient space remaining
+ */
+static __inline__ __attribute__((always_inline)) void *TPCircularBufferBatchReserveRecord(TPCircularBufferBatch *batch,
+                                                                                         int32_t length) {
+    void *ptr = TPCircularBufferBatchReserve(batch, TPCircularBufferRecordTotalLength(length));
+    if ( !ptr ) return NULL;
+    return _TPCircularBufferInitRecord(ptr, length);
+}
+
+#pragma mark - Reading (consuming)
+
+/*!
+ * Access the next record
+ *
+ * @param buffer Circular buffer
+ * @param length On output, the payload length
+ * @return Pointer to the payload, or NULL if there are no records
+ */
+static __inline__ __attribute__((always_inline)) const void *TPCircularBufferPeekRecord(const TPCircularBuffer *buffer,
+                                                                                       int32_t *length) {
+    TPCircularBufferLength available;
+    const TPCircularBufferRecordHeader *header = (const TPCircularBufferRecordHeader *)TPCircularBufferTail(buffer, &available);
+    if ( !header ) return NULL;
+    assert(header->totalLength <= available);
+    *length = header->length;
+    return (const char *)header + kTPCircularBufferRecordHeaderLength;
+}
+
+/*!
+ * Release the next record
+ *
+ *  Frees up the record returned by TPCircularBufferPeekRecord. The record's
+ *  header is already known to be available, so this doesn't query the buffer again.
+ *
+ * @param buffer Circular buffer
+ */
+static __inline__ __attribute__((always_inline)) void TPCircularBufferReleaseRecord(TPCircularBuffer *buffer) {
+    const TPCircularBufferRecordHeader *header = (const TPCircularBufferRecordHeader *)((char *)buffer->buffer + buffer->tail);
+    TPCircularBufferConsume(buffer, header->totalLength);
+}
+
+/*!
+ * Take the next record from a read batch
+ *
+ *  Records taken this way are released together by TPCircularBufferCommitReadBatch.
+ *
+ * @param batch The batch
+ * @param length On output, the payload length
+ * @return Pointer to the payload, or NULL if there are no more records in the batch
+ */
+static __inline__ __attribute__((always_inline)) const void *TPCircularBufferBatchNextRecord(TPCircularBufferBatch *batch,
+                                                                                            int32_t *length) {
+    if ( batch->available - batch->length < kTPCircularBufferRecordHeaderLength ) return NULL;
+    const TPCircularBufferRecordHeader *header = (const TPCircularBufferRecordHeader *)(batch->bytes + batch->length);
+    assert(header->totalLength <= batch->available - batch->length);
+    batch->length += header->totalLength;
+    *length = header->length;
+    return (const char *)header + kTPCircularBufferRecordHeaderLength;
+}
+
+#pragma mark - Multiple producers
+
+/*!
+ * Reserve a record for writing, with multiple producers
+ *
+ *  Fill in the payload, then pass the reservation to TPMultiProducerCircularBufferCommit.
+ *
+ * @param buffer Circular buffer
+ * @param length Payload length
+ * @param reservation On output, the reservation to pass to TPMultiProducerCircularBufferCommit
+ * @return Pointer to the payload, or NULL if there's insufficient space or too many outstanding reservations
+ */
+static __inline__ __attribute__((always_inline)) void *TPMultiProducerCircularBufferReserveRecord(TPMultiProducerCircularBuffer *buffer,
+                                                                                                 int32_t length,
+                                                                                                 TPMultiProducerCircularBufferReservation *reservation) {
+    void *ptr = TPMultiProducerCircularBufferReserve(buffer, TPCircularBufferRecordTotalLength(length), reservation);
+    if ( !ptr ) return NULL;
+    return _TPCircularBufferInitRecord(ptr, length);
+}
+
+/*!
+ * Access the next record, with multiple producers
+ *
+ * @param buffer Circular buffer
+ * @param length On output, the payload length
+ * @return Pointer to the payload, or NULL if there are no records
+ */
+static __inline__ __attribute__((always_inline)) const void *TPMultiProducerCircularBufferPeekRecord(TPMultiProducerCircularBuffer *buffer,
+                                                                                                    int32_t *length) {
+    int32_t available;
+    const TPCircularBufferRecordHeader *header = (const TPCircularBufferRecordHeader *)TPMultiProducerCircularBufferTail(buffer, &available);
+    if ( !header ) return NULL;
+    assert(header->totalLength <= available);
+    *length = header->length;
+    return (const char *)header + kTPCircularBufferRecordHeaderLength;
+}
+
+/*!
+ * Release the next record, with multiple producers
+ *
+ * @param buffer Circular buffer
+ */
+static __inline__ __attribute__((always_inline)) void TPMultiProducerCircularBufferReleaseRecord(TPMultiProducerCircularBuffer *buffer) {
+    const TPCircularBufferRecordHeader *header =
+        (const TPCircularBufferRecordHeader *)((char *)buffer->buffer.buffer + buffer->buffer.tail);
+    TPMultiProducerCircularBufferConsume(buffer, header->totalLength);
+}
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
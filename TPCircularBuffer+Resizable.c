@@ -0,0 +1,127 @@
+//
+//  TPCircularBuffer+Resizable.c
+//  Circular/Ring buffer implementation
+//
+//  https://github.com/michaeltyson/TPCircularBuffer
+//
+//  Copyright (C) 2012-2013 A Tasty Pixel
+//
+//  This software is provided 'as-is', without any express or implied
+//  warranty.  In no event will the authors be held liable for any damages
+//  arising from the use of this software.
+//
+//  Permission is granted to anyone to use this software for any purpose,
+//  including commercial applications, and to alter it and redistribute it
+//  freely, subject to the following restrictions:
+//
+//  1. The origin of this software must not be misrepresented; you must not
+//     claim that you wrote the original software. If you use this software
+//     in a product, an acknowledgment in the product documentation would be
+//     appreciated but is not required.
+//
+//  2. Altered source versions must be plainly marked as such, and must not be
+//     misrepresented as being the original software.
+//
+//  3. This notice may not be removed or altered from any source distribution.
+//
+
+#include "TPCircularBuffer+Resizable.h"
+
+#include <stdlib.h>
+#include <stdio.h>
+
+static TPResizableCircularBufferSegment *createSegment(TPCircularBufferLength length) {
+    TPResizableCircularBufferSegment *segment =
+        (TPResizableCircularBufferSegment *)malloc(sizeof(TPResizableCircularBufferSegment));
+    if ( !segment ) return NULL;
+    if ( !TPCircularBufferInit(&segment->buffer, length) ) {
+        free(segment);
+        return NULL;
+    }
+    atomic_store_explicit(&segment->next, 0, memory_order_relaxed);
+    return segment;
+}
+
+static void destroySegment(TPResizableCircularBufferSegment *segment) {
+    TPCircularBufferCleanup(&segment->buffer);
+    free(segment);
+}
+
+bool _TPResizableCircularBufferInit(TPResizableCircularBuffer *buffer, TPCircularBufferLength length, size_t structSize) {
+    if ( structSize != sizeof(TPResizableCircularBuffer) ) {
+        fprintf(stderr,
+                "TPCircularBuffer: Header version mismatch. "
+                "Check for old versions of TPCircularBuffer in your project.\n");
+        abort();
+    }
+
+    TPResizableCircularBufferSegment *segment = createSegment(length);
+    if ( !segment ) {
+        return false;
+    }
+
+    buffer->producerSegment = segment;
+    buffer->oldestSegment = segment;
+    atomic_store_explicit(&buffer->requestedSegment, 0, memory_order_relaxed);
+    atomic_store_explicit(&buffer->consumerSegment, (uintptr_t)segment, memory_order_release);
+    return true;
+}
+
+void TPResizableCircularBufferCleanup(TPResizableCircularBuffer *buffer) {
+    TPResizableCircularBufferSegment *segment = buffer->oldestSegment;
+    while ( segment ) {
+        TPResizableCircularBufferSegment *next =
+            (TPResizableCircularBufferSegment *)atomic_load_explicit(&segment->next, memory_order_acquire);
+        destroySegment(segment);
+        segment = next;
+    }
+
+    uintptr_t requested = atomic_load_explicit(&buffer->requestedSegment, memory_order_acquire);
+    if ( requested ) {
+        destroySegment((TPResizableCircularBufferSegment *)requested);
+    }
+
+    memset(buffer, 0, sizeof(TPResizableCircularBuffer));
+}
+
+bool TPResizableCircularBufferResize(TPResizableCircularBuffer *buffer, TPCircularBufferLength length) {
+    TPResizableCircularBufferCollect(buffer);
+
+    TPResizableCircularBufferSegment *segment = createSegment(length);
+    if ( !segment ) {
+        return false;
+    }
+
+    // If the producer hasn't taken the last one yet, it never will now
+    uintptr_t replaced = atomic_exchange_explicit(&buffer->requestedSegment, (uintptr_t)segment, memory_order_acq_rel);
+    if ( replaced ) {
+        destroySegment((TPResizableCircularBufferSegment *)replaced);
+    }
+    return true;
+}
+
+void TPResizableCircularBufferCollect(TPResizableCircularBuffer *buffer) {
+    // Segments before the consumer's are finished with by both sides
+    TPResizableCircularBufferSegment *consumerSegment =
+        (TPResizableCircularBufferSegment *)atomic_load_explicit(&buffer->consumerSegment, memory_order_acquire);
+    while ( buffer->oldestSegment != consumerSegment ) {
+        TPResizableCircularBufferSegment *next =
+            (TPResizableCircularBufferSegment *)atomic_load_explicit(&buffer->oldestSegment->next, memory_order_relaxed);
+        destroySegment(buffer->oldestSegment);
+        buffer->oldestSegment = next;
+    }
+}
+
+void *_TPResizableCircularBufferAdvanceConsumer(TPResizableCircularBuffer *buffer, TPCircularBufferLength *availableBytes) {
+    TPResizableCircularBufferSegment *segment = _TPResizableCircularBufferConsumerSegment(buffer);
+    uintptr_t next;
+    while ( (next = atomic_load_explicit(&segment->next, memory_order_acquire)) ) {
+        // The producer has moved on, and everything it produced here is now visible,
+        // so once this segment is empty, it's finished with
+        void *tail = TPCircularBufferTail(&segment->buffer, availableBytes);
+        if ( tail ) return tail;
+        segment = (TPResizableCircularBufferSegment *)next;
+        atomic_store_explicit(&buffer->consumerSegment, next, memory_order_release);
+    }
+    return TPCircularBufferTail(&segment->buffer, availableBytes);
+}
@@ -0,0 +1,202 @@
+//
+//  TPCircularBuffer+Resizable.h
+//  Circular/Ring buffer implementation
+//
+//  https://github.com/michaeltyson/TPCircularBuffer
+//
+//  A buffer that can be grown or shrunk while its producer and consumer keep running.
+//
+//  Resizing allocates a new buffer of the new size, and asks the producer to switch to
+//  it. The producer does so at its next TPResizableCircularBufferHead, linking the new
+//  buffer after the old one; the consumer finishes reading the old buffer, then follows
+//  the link. So bytes stay in order, and none need to be copied between buffers. Neither
+//  side blocks, allocates or frees memory: that's left to the thread that resizes, which
+//  frees buffers once the consumer has moved past them.
+//
+//  Copyright (C) 2012-2013 A Tasty Pixel
+//
+//  This software is provided 'as-is', without any express or implied
+//  warranty.  In no event will the authors be held liable for any damages
+//  arising from the use of this software.
+//
+//  Permission is granted to anyone to use this software for any purpose,
+//  including commercial applications, and to alter it and redistribute it
+//  freely, subject to the following restrictions:
+//
+//  1. The origin of this software must not be misrepresented; you must not
+//     claim that you wrote the original software. If you use this software
+//     in a product, an acknowledgment in the product documentation would be
+//     appreciated but is not required.
+//
+//  2. Altered source versions must be plainly marked as such, and must not be
+//     misrepresented as being the original software.
+//
+//  3. This notice may not be removed or altered from any source distribution.
+//
+
+#ifndef TPCircularBuffer_Resizable_h
+#define TPCircularBuffer_Resizable_h
+
+#include "TPCircularBuffer.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef struct {
+    TPCircularBuffer  buffer;
+    atomic_uintptr_t  next;                         // The segment the producer moved on to, once it has
+} TPResizableCircularBufferSegment;
+
+typedef struct {
+    TPResizableCircularBufferSegment *producerSegment;
+    atomic_uintptr_t  requestedSegment;             // A new segment, until the producer takes it
+    _TPCircularBufferCacheLinePadding(_padding0)
+    atomic_uintptr_t  consumerSegment;
+    _TPCircularBufferCacheLinePadding(_padding1)
+    TPResizableCircularBufferSegment *oldestSegment; // Owned by the thread that resizes
+} TPResizableCircularBuffer;
+
+/*!
+ * Initialise buffer
+ *
+ *  As with TPCircularBufferInit, the length will be rounded up to a multiple of
+ *  the device page size.
+ *
+ * @param buffer Circular buffer
+ * @param length Initial length of buffer
+ */
+#define TPResizableCircularBufferInit(buffer, length) \
+    _TPResizableCircularBufferInit(buffer, length, sizeof(*buffer))
+bool _TPResizableCircularBufferInit(TPResizableCircularBuffer *buffer, TPCircularBufferLength length, size_t structSize);
+
+/*!
+ * Cleanup buffer
+ *
+ *  Releases buffer resources. The producer and consumer must have stopped.
+ */
+void TPResizableCircularBufferCleanup(TPResizableCircularBuffer *buffer);
+
+/*!
+ * Resize buffer
+ *
+ *  Allocates a buffer of the new length, which the producer will switch to at its
+ *  next TPResizableCircularBufferHead. Bytes already in the buffer stay where they
+ *  are until the consumer reads them. If the producer hasn't yet switched to the
+ *  buffer from an earlier resize, this one replaces it.
+ *
+ *  Call this, TPResizableCircularBufferCollect and TPResizableCircularBufferCleanup
+ *  from only one thread at a time, which shouldn't be the producer or consumer as
+ *  this allocates and frees memory.
+ *
+ * @param buffer Circular buffer
+ * @param length New length of buffer
+ * @return true on success, false if the new buffer couldn't be allocated
+ */
+bool TPResizableCircularBufferResize(TPResizableCircularBuffer *buffer, TPCircularBufferLength length);
+
+/*!
+ * Free buffers the consumer has finished with
+ *
+ *  TPResizableCircularBufferResize does this too, so call it only if you want
+ *  memory from earlier resizes back sooner.
+ *
+ * @param buffer Circular buffer
+ */
+void TPResizableCircularBufferCollect(TPResizableCircularBuffer *buffer);
+
+#pragma mark - Writing (producing)
+
+/*!
+ * Access front of buffer
+ *
+ *  As TPCircularBufferHead. If the buffer has been resized, this is where the
+ *  producer switches to the new buffer.
+ *
+ * @param buffer Circular buffer
+ * @param availableBytes On output, the number of bytes ready for writing
+ * @return Pointer to the first bytes ready for writing, or NULL if buffer is full
+ */
+static __inline__ __attribute__((always_inline)) void *TPResizableCircularBufferHead(TPResizableCircularBuffer *buffer,
+                                                                                    TPCircularBufferLength *availableBytes) {
+    if ( atomic_load_explicit(&buffer->requestedSegment, memory_order_relaxed) ) {
+        uintptr_t requested = atomic_exchange_explicit(&buffer->requestedSegment, 0, memory_order_acquire);
+        if ( requested ) {
+            // Everything we produced to the old segment is published before the link to the new one
+            atomic_store_explicit(&buffer->producerSegment->next, requested, memory_order_release);
+            buffer->producerSegment = (TPResizableCircularBufferSegment *)requested;
+        }
+    }
+    TPCircularBufferLength discard;
+    return TPCircularBufferHead(&buffer->producerSegment->buffer, availableBytes, &discard);
+}
+
+/*!
+ * Produce bytes in buffer
+ *
+ * @param buffer Circular buffer
+ * @param amount Number of bytes to produce
+ */
+static __inline__ __attribute__((always_inline)) void TPResizableCircularBufferProduce(TPResizableCircularBuffer *buffer,
+                                                                                      TPCircularBufferLength amount) {
+    TPCircularBufferProduce(&buffer->producerSegment->buffer, amount);
+}
+
+/*!
+ * Helper routine to copy bytes to buffer
+ *
+ * @param buffer Circular buffer
+ * @param src Source buffer
+ * @param len Number of bytes in source buffer
+ * @return true if bytes copied, false if there was insufficient space
+ */
+static __inline__ __attribute__((always_inline)) bool TPResizableCircularBufferProduceBytes(TPResizableCircularBuffer *buffer,
+                                                                                           const void *src,
+                                                                                           TPCircularBufferLength len) {
+    TPCircularBufferLength space;
+    TPResizableCircularBufferHead(buffer, &space);
+    return TPCircularBufferProduceBytes(&buffer->producerSegment->buffer, src, len);
+}
+
+#pragma mark - Reading (consuming)
+
+static __inline__ __attribute__((always_inline)) TPResizableCircularBufferSegment *_TPResizableCircularBufferConsumerSegment(const TPResizableCircularBuffer *buffer) {
+    return (TPResizableCircularBufferSegment *)atomic_load_explicit(&buffer->consumerSegment, memory_order_relaxed);
+}
+
+void *_TPResizableCircularBufferAdvanceConsumer(TPResizableCircularBuffer *buffer, TPCircularBufferLength *availableBytes);
+
+/*!
+ * Access end of buffer
+ *
+ *  As TPCircularBufferTail. Once the consumer has read everything produced before
+ *  a resize, this is where it switches to the new buffer.
+ *
+ * @param buffer Circular buffer
+ * @param availableBytes On output, the number of bytes ready for reading
+ * @return Pointer to the first bytes ready for reading, or NULL if buffer is empty
+ */
+static __inline__ __attribute__((always_inline)) void *TPResizableCircularBufferTail(TPResizableCircularBuffer *buffer,
+                                                                                    TPCircularBufferLength *availableBytes) {
+    TPResizableCircularBufferSegment *segment = _TPResizableCircularBufferConsumerSegment(buffer);
+    void *tail = TPCircularBufferTail(&segment->buffer, availableBytes);
+    if ( tail || !atomic_load_explicit(&segment->next, memory_order_relaxed) ) return tail;
+    return _TPResizableCircularBufferAdvanceConsumer(buffer, availableBytes);
+}
+
+/*!
+ * Consume bytes in buffer
+ *
+ * @param buffer Circular buffer
+ * @param amount Number of bytes to consume
+ */
+static __inline__ __attribute__((always_inline)) void TPResizableCircularBufferConsume(TPResizableCircularBuffer *buffer,
+                                                                                      TPCircularBufferLength amount) {
+    TPCircularBufferConsume(&_TPResizableCircularBufferConsumerSegment(buffer)->buffer, amount);
+}
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -0,0 +1,257 @@
+//
+//  TPCircularBuffer+Shared.c
+//  Circular/Ring buffer implementation
+//
+//  https://github.com/michaeltyson/TPCircularBuffer
+//
+//  Copyright (C) 2012-2013 A Tasty Pixel
+//
+//  This software is provided 'as-is', without any express or implied
+//  warranty.  In no event will the authors be held liable for any damages
+//  arising from the use of this software.
+//
+//  Permission is granted to anyone to use this software for any purpose,
+//  including commercial applications, and to alter it and redistribute it
+//  freely, subject to the following restrictions:
+//
+//  1. The origin of this software must not be misrepresented; you must not
+//     claim that you wrote the original software. If you use this software
+//     in a product, an acknowledgment in the product documentation would be
+//     appreciated but is not required.
+//
+//  2. Altered source versions must be plainly marked as such, and must not be
+//     misrepresented as being the original software.
+//
+//  3. This notice may not be removed or altered from any source distribution.
+//
+
+#if defined(__linux__) && !defined(_GNU_SOURCE)
+#define _GNU_SOURCE // For memfd_create and MAP_FIXED_NOREPLACE
+#endif
+
+#include "TPCircularBuffer+Shared.h"
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <stddef.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#ifndef MAP_FIXED_NOREPLACE
+#define MAP_FIXED_NOREPLACE 0 // Treat the address as a hint, and check where the mapping lands
+#endif
+
+static const uint32_t kSharedMagic = 0x54504342; // 'TPCB'
+
+/*!
+ * The start of the shared memory object, followed by the buffer memory on the next page
+ */
+typedef struct {
+    atomic_uint             magic;          // Set once the rest is initialised
+    uint32_t                headerSize;     // Differs if processes are built with different configurations
+    uint64_t                address;        // Where every process maps the shared object
+    TPCircularBufferLength  length;
+    int32_t                 controlLength;  // Offset of the buffer memory
+    TPCircularBuffer        buffer;
+} TPSharedCircularBufferHeader;
+
+static void reportError(const char *operation) {
+    fprintf(stderr, "TPCircularBuffer: %s: %s.\n", operation, strerror(errno));
+}
+
+static size_t roundToPage(size_t length) {
+    size_t pageSize = (size_t)sysconf(_SC_PAGESIZE);
+    return (length + pageSize - 1) & ~(pageSize - 1);
+}
+
+static int createSharedMemory(const char *name) {
+    if ( name ) {
+        return shm_open(name, O_RDWR | O_CREAT | O_EXCL, 0600);
+    }
+#if defined(__linux__)
+    return memfd_create("TPCircularBuffer", MFD_CLOEXEC);
+#else
+    // Create a uniquely-named object, and remove the name straight away
+    static atomic_uint counter;
+    for ( int retries = 3; ; retries-- ) {
+        char uniqueName[64];
+        snprintf(uniqueName, sizeof(uniqueName), "/TPCircularBuffer.%d.%u",
+                 (int)getpid(), atomic_fetch_add_explicit(&counter, 1, memory_order_relaxed));
+        int fd = shm_open(uniqueName, O_RDWR | O_CREAT | O_EXCL, 0600);
+        if ( fd >= 0 ) {
+            shm_unlink(uniqueName);
+            return fd;
+        }
+        if ( errno != EEXIST || retries == 0 ) {
+            return -1;
+        }
+    }
+#endif
+}
+
+/*!
+ * Map the control page and buffer, with the buffer's mirror immediately after
+ *
+ * @param address Address to map at, or NULL for anywhere
+ */
+static TPSharedCircularBufferHeader *mapSharedMemory(int fd, void *address, size_t controlLength, size_t length) {
+    size_t mappingLength = controlLength + length * 2;
+
+    // Reserve the address space for everything first
+    char *base = (char *)mmap(address,
+                              mappingLength,
+                              PROT_NONE,
+                              MAP_PRIVATE | MAP_ANONYMOUS | (address ? MAP_FIXED_NOREPLACE : 0),
+                              -1,
+                              0);
+    if ( base == MAP_FAILED ) {
+        return NULL;
+    }
+    if ( address && base != (char *)address ) {
+        munmap(base, mappingLength);
+        errno = EEXIST;
+        return NULL;
+    }
+
+    if ( mmap(base,
+              controlLength + length,
+              PROT_READ | PROT_WRITE,
+              MAP_SHARED | MAP_FIXED,
+              fd,
+              0) != base
+            || mmap(base + controlLength + length,
+                    length,
+                    PROT_READ | PROT_WRITE,
+                    MAP_SHARED | MAP_FIXED,
+                    fd,
+                    (off_t)controlLength) != base + controlLength + length ) {
+        int error = errno;
+        munmap(base, mappingLength);
+        errno = error;
+        return NULL;
+    }
+
+    return (TPSharedCircularBufferHeader *)base;
+}
+
+TPCircularBuffer *TPCircularBufferCreateShared(const char *name, TPCircularBufferLength length, int *fileDescriptor) {
+    assert(length > 0);
+
+    size_t controlLength = roundToPage(sizeof(TPSharedCircularBufferHeader));
+    size_t bufferLength = roundToPage((size_t)length);
+    if ( bufferLength > (size_t)kTPCircularBufferMaxLength ) {
+        fprintf(stderr, "TPCircularBuffer: Shared buffer length too large.\n");
+        return NULL;
+    }
+
+    int fd = createSharedMemory(name);
+    if ( fd < 0 ) {
+        reportError("Create shared memory");
+        return NULL;
+    }
+
+    TPSharedCircularBufferHeader *header = NULL;
+    if ( ftruncate(fd, (off_t)(controlLength + bufferLength)) != 0 ) {
+        reportError("Size shared memory");
+    } else if ( !(header = mapSharedMemory(fd, NULL, controlLength, bufferLength)) ) {
+        reportError("Map shared memory");
+    }
+    if ( !header ) {
+        int error = errno;
+        close(fd);
+        if ( name ) shm_unlink(name);
+        errno = error;
+        return NULL;
+    }
+
+    header->headerSize = sizeof(TPSharedCircularBufferHeader);
+    header->address = (uint64_t)(uintptr_t)header;
+    header->length = (TPCircularBufferLength)bufferLength;
+    header->controlLength = (int32_t)controlLength;
+    header->buffer.buffer = (char *)header + controlLength;
+    header->buffer.length = (TPCircularBufferLength)bufferLength;
+    header->buffer.pageSize = (int32_t)sysconf(_SC_PAGESIZE);
+    header->buffer.appliedOptions = 0;
+    _TPCircularBufferInitState(&header->buffer);
+    atomic_store_explicit(&header->magic, kSharedMagic, memory_order_release);
+
+    if ( fileDescriptor ) {
+        *fileDescriptor = fd;
+    } else {
+        close(fd);
+    }
+
+    return &header->buffer;
+}
+
+TPCircularBuffer *TPCircularBufferAttachShared(const char *name) {
+    int fd = shm_open(name, O_RDWR, 0);
+    if ( fd < 0 ) {
+        reportError("Open shared memory");
+        return NULL;
+    }
+    TPCircularBuffer *buffer = TPCircularBufferAttachSharedFileDescriptor(fd);
+    close(fd);
+    return buffer;
+}
+
+TPCircularBuffer *TPCircularBufferAttachSharedFileDescriptor(int fileDescriptor) {
+    size_t controlLength = roundToPage(sizeof(TPSharedCircularBufferHeader));
+
+    struct stat info;
+    if ( fstat(fileDescriptor, &info) != 0 ) {
+        reportError("Inspect shared memory");
+        return NULL;
+    }
+
+    // Read the header to find out where the buffer goes, and how long it is
+    bool valid = false;
+    uint64_t address = 0;
+    TPCircularBufferLength length = 0;
+    if ( (size_t)info.st_size >= controlLength ) {
+        const TPSharedCircularBufferHeader *header =
+            (const TPSharedCircularBufferHeader *)mmap(NULL, controlLength, PROT_READ, MAP_SHARED, fileDescriptor, 0);
+        if ( header == MAP_FAILED ) {
+            reportError("Map shared memory");
+            return NULL;
+        }
+        valid = atomic_load_explicit((atomic_uint *)&header->magic, memory_order_acquire) == kSharedMagic
+                && header->headerSize == sizeof(TPSharedCircularBufferHeader)
+                && header->controlLength == (int32_t)controlLength
+                && (off_t)controlLength + header->length == info.st_size;
+        address = header->address;
+        length = header->length;
+        munmap((void *)header, controlLength);
+    }
+    if ( !valid ) {
+        fprintf(stderr,
+                "TPCircularBuffer: Not a shared buffer, or it was created with a different "
+                "TPCircularBuffer version or configuration.\n");
+        return NULL;
+    }
+
+    TPSharedCircularBufferHeader *header = mapSharedMemory(fileDescriptor, (void *)(uintptr_t)address, controlLength, (size_t)length);
+    if ( !header ) {
+        reportError("Map shared memory at the creating process's address");
+        return NULL;
+    }
+
+    return &header->buffer;
+}
+
+void TPCircularBufferDetachShared(TPCircularBuffer *buffer) {
+    TPSharedCircularBufferHeader *header =
+        (TPSharedCircularBufferHeader *)((char *)buffer - offsetof(TPSharedCircularBufferHeader, buffer));
+    munmap(header, (size_t)header->controlLength + (size_t)header->length * 2);
+}
+
+bool TPCircularBufferUnlinkShared(const char *name) {
+    if ( shm_unlink(name) != 0 ) {
+        reportError("Unlink shared memory");
+        return false;
+    }
+    return true;
+}
@@ -0,0 +1,115 @@
+//
+//  TPCircularBuffer+Shared.h
+//  Circular/Ring buffer implementation
+//
+//  https://github.com/michaeltyson/TPCircularBuffer
+//
+//  Buffers shared between processes. The buffer's control state and its mirrored
+//  memory live together in one shared memory object, which other processes attach
+//  to by name or by a file descriptor passed to them (e.g. over a UNIX socket with
+//  SCM_RIGHTS). Once attached, the usual TPCircularBufferHead, TPCircularBufferProduce,
+//  TPCircularBufferTail and TPCircularBufferConsume work across the processes with no
+//  copying, with one producer and one consumer as usual.
+//
+//  Because the buffer structure records the address of its memory, every process maps
+//  the shared object at the address the creating process chose. Attaching fails if
+//  that address range is already in use in the attaching process, which is rare in a
+//  64-bit address space, particularly if processes attach early.
+//
+//  Both processes must be built with the same TPCIRCULARBUFFER_* configuration; this
+//  is checked on attach.
+//
+//  Copyright (C) 2012-2013 A Tasty Pixel
+//
+//  This software is provided 'as-is', without any express or implied
+//  warranty.  In no event will the authors be held liable for any damages
+//  arising from the use of this software.
+//
+//  Permission is granted to anyone to use this software for any purpose,
+//  including commercial applications, and to alter it and redistribute it
+//  freely, subject to the following restrictions:
+//
+//  1. The origin of this software must not be misrepresented; you must not
+//     claim that you wrote the original software. If you use this software
+//     in a product, an acknowledgment in the product documentation would be
+//     appreciated but is not required.
+//
+//  2. Altered source versions must be plainly marked as such, and must not be
+//     misrepresented as being the original software.
+//
+//  3. This notice may not be removed or altered from any source distribution.
+//
+
+#ifndef TPCircularBuffer_Shared_h
+#define TPCircularBuffer_Shared_h
+
+#include "TPCircularBuffer.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*!
+ * Create a shared buffer
+ *
+ *  Creates a shared memory object holding a new, empty buffer, and maps it. If a
+ *  name is given, the object is created with shm_open, and other processes may
+ *  attach to it with TPCircularBufferAttachShared; creation fails if an object with
+ *  that name already exists. Otherwise, the object is anonymous, and other processes
+ *  may only attach to it with a file descriptor passed to them.
+ *
+ *  As with TPCircularBufferInit, the length will be rounded up to a multiple of the
+ *  device page size.
+ *
+ * @param name Shared memory object name, beginning with a slash, or NULL for an anonymous object
+ * @param length Length of buffer
+ * @param fileDescriptor If not NULL, on output, a descriptor for the shared memory object, which the caller must close
+ * @return The shared buffer, or NULL on error
+ */
+TPCircularBuffer *TPCircularBufferCreateShared(const char *name, TPCircularBufferLength length, int *fileDescriptor);
+
+/*!
+ * Attach to a shared buffer by name
+ *
+ * @param name Name the buffer was created with
+ * @return The shared buffer, or NULL on error
+ */
+TPCircularBuffer *TPCircularBufferAttachShared(const char *name);
+
+/*!
+ * Attach to a shared buffer by file descriptor
+ *
+ *  The descriptor remains owned by the caller, and may be closed once this returns.
+ *
+ * @param fileDescriptor Descriptor for the shared memory object
+ * @return The shared buffer, or NULL on error
+ */
+TPCircularBuffer *TPCircularBufferAttachSharedFileDescriptor(int fileDescriptor);
+
+/*!
+ * Detach from a shared buffer
+ *
+ *  Unmaps the buffer from this process. The buffer itself persists until every
+ *  process has detached and, for named buffers, the name has been removed with
+ *  TPCircularBufferUnlinkShared. Use this instead of TPCircularBufferCleanup for
+ *  shared buffers, both in the creating process and in attached ones.
+ *
+ * @param buffer The shared buffer
+ */
+void TPCircularBufferDetachShared(TPCircularBuffer *buffer);
+
+/*!
+ * Remove a shared buffer's name
+ *
+ *  Processes already attached are unaffected, but no more may attach by name.
+ *
+ * @param name Name the buffer was created with
+ * @return true on success, false on error
+ */
+bool TPCircularBufferUnlinkShared(const char *name);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -0,0 +1,394 @@
+//
+//  TPCircularBuffer+Typed.h
+//  Circular/Ring buffer implementation
+//
+//  https://github.com/michaeltyson/TPCircularBuffer
+//
+//  A C++ template over the byte buffer that holds objects of one type in place.
+//  Elements are constructed directly in the buffer's memory, moved out when read,
+//  and destroyed as they're consumed, so any movable type can go through the buffer
+//  without being trivially copyable and without heap allocations of its own.
+//
+//  As with the byte buffer, the mirrored mapping means available elements are
+//  always one contiguous array, even across the end of the buffer, so they can be
+//  read or written in place. It's safe for a single producer and single consumer.
+//
+//  Policies fix the buffer's behaviour at compile time: whether it uses atomic operations,
+//  which replaces TPCircularBufferSetAtomic and the runtime test that goes with it, and how
+//  emplace waits for space. The index scheme is set for the whole program by
+//  TPCIRCULARBUFFER_CACHED_INDICES, as it changes the buffer structure.
+//
+//  Header only; include it from C++ and link TPCircularBuffer.c as usual.
+//
+//  Copyright (C) 2012-2013 A Tasty Pixel
+//
+//  This software is provided 'as-is', without any express or implied
+//  warranty.  In no event will the authors be held liable for any damages
+//  arising from the use of this software.
+//
+//  Permission is granted to anyone to use this software for any purpose,
+//  including commercial applications, and to alter it and redistribute it
+//  freely, subject to the following restrictions:
+//
+//  1. The origin of this software must not be misrepresented; you must not
+//     claim that you wrote the original software. If you use this software
+//     in a product, an acknowledgment in the product documentation would be
+//     appreciated but is not required.
+//
+//  2. Altered source versions must be plainly marked as such, and must not be
+//     misrepresented as being the original software.
+//
+//  3. This notice may not be removed or altered from any source distribution.
+//
+
+#ifndef TPCircularBuffer_Typed_h
+#define TPCircularBuffer_Typed_h
+
+#include "TPCircularBuffer.h"
+
+#ifdef __cplusplus
+
+#include <cstddef>
+#include <new>
+#include <thread>
+#include <utility>
+#include <type_traits>
+
+#if __cplusplus >= 202002L
+    #include <span>
+#endif
+
+/*!
+ * Atomicity policy: the producer and consumer are on different threads
+ */
+struct TPCircularBufferAtomicPolicy {
+    static const bool atomic = true;
+};
+
+/*!
+ * Atomicity policy: the producer and consumer are on the same thread
+ */
+struct TPCircularBufferNonAtomicPolicy {
+    static const bool atomic = false;
+};
+
+/*!
+ * Wait policy: give up the CPU while waiting for space
+ */
+struct TPCircularBufferYieldWait {
+    static void wait() {
+        std::this_thread::yield();
+    }
+};
+
+/*!
+ * Wait policy: spin while waiting for space, for a consumer on another core that's sure to keep up
+ */
+struct TPCircularBufferSpinWait {
+    static void wait() {
+#if defined(__x86_64__) || defined(__i386__)
+        __builtin_ia32_pause();
+#elif defined(__aarch64__)
+        __asm__ __volatile__("yield");
+#endif
+    }
+};
+
+/*!
+ * A circular buffer of objects of type T
+ *
+ *  Elements stay at the address they were constructed at until they're consumed.
+ *  Buffer lengths are whole pages, so when sizeof(T) doesn't divide the page size
+ *  an element may straddle the end of the buffer; the mirror keeps it contiguous.
+ *
+ *  Atomicity is TPCircularBufferAtomicPolicy or TPCircularBufferNonAtomicPolicy, and
+ *  WaitPolicy is TPCircularBufferYieldWait or TPCircularBufferSpinWait, or a class with
+ *  the same static wait() function.
+ */
+template <typename T,
+          typename Atomicity = TPCircularBufferAtomicPolicy,
+          typename WaitPolicy = TPCircularBufferYieldWait>
+class TPTypedCircularBuffer {
+    static_assert(alignof(T) <= 4096, "Elements can't be aligned beyond the page size");
+
+public:
+    TPTypedCircularBuffer() : buffer_() {}
+
+    /*!
+     * Destroy buffer
+     *
+     *  Destroys any elements still in the buffer, and releases buffer resources.
+     *  The producer and consumer must have stopped.
+     */
+    ~TPTypedCircularBuffer() {
+        if ( !buffer_.buffer ) return;
+        size_t count;
+        while ( tail(count) ) {
+            consume(count);
+        }
+        TPCircularBufferCleanup(&buffer_);
+    }
+
+    TPTypedCircularBuffer(const TPTypedCircularBuffer &) = delete;
+    TPTypedCircularBuffer &operator=(const TPTypedCircularBuffer &) = delete;
+
+    /*!
+     * Initialise buffer
+     *
+     *  As with TPCircularBufferInit, the length will be rounded up to a multiple of
+     *  the page size, so the buffer may hold more elements than asked for.
+     *
+     * @param capacity Minimum number of elements the buffer can hold
+     * @param options Combination of kTPCircularBufferOption values
+     * @return true on success, false if the buffer couldn't be created
+     */
+    bool init(size_t capacity, TPCircularBufferOptions options = 0) {
+        assert(!buffer_.buffer);
+        if ( capacity == 0 || capacity > (size_t)kTPCircularBufferMaxLength / sizeof(T) ) return false;
+        return TPCircularBufferInitWithOptions(&buffer_, (TPCircularBufferLength)(capacity * sizeof(T)), options);
+    }
+
+    /*!
+     * Number of elements the buffer can hold
+     */
+    size_t capacity() const {
+        return (size_t)buffer_.length / sizeof(T);
+    }
+
+    /*!
+     * The underlying byte buffer
+     *
+     *  For TPCircularBufferGetStats. Producing or consuming through it directly
+     *  would break up elements, and TPCircularBufferSetAtomic has no effect on it.
+     */
+    TPCircularBuffer *buffer() {
+        return &buffer_;
+    }
+
+#pragma mark - Writing (producing)
+
+    /*!
+     * Access front of buffer
+     *
+     *  This gives you a pointer to the uninitialised storage for the next elements,
+     *  to construct them in place, then publish with produce.
+     *
+     * @param count On output, the number of elements there is space for
+     * @param wanted If there appears to be space for fewer, look again before giving up
+     * @return Pointer to storage for the next element, or NULL if buffer is full
+     */
+    T *head(size_t &count, size_t wanted = 1) {
+        TPCircularBufferLength space, discard;
+        void *ptr = _TPCircularBufferHead(&buffer_, &space, &discard, Atomicity::atomic);
+#if TPCIRCULARBUFFER_CACHED_INDICES
+        if ( (size_t)space < wanted * sizeof(T) ) {
+            // The cached view of the consumer may be stale; look again before giving up
+            _TPCircularBufferProducerFillCount(&buffer_, Atomicity::atomic, true);
+            ptr = _TPCircularBufferHead(&buffer_, &space, &discard, Atomicity::atomic);
+        }
+#else
+        (void)wanted;
+#endif
+        assert(discard == 0); // Only bytes consumed past the producer need discarding
+        count = (size_t)space / sizeof(T);
+        if ( count == 0 ) {
+            _TPCircularBufferStatsFull(&buffer_);
+            return NULL;
+        }
+        return (T *)ptr;
+    }
+
+    /*!
+     * Produce elements
+     *
+     *  Marks the given number of elements, constructed at head, ready for reading.
+     *
+     * @param count Number of elements to produce
+     */
+    void produce(size_t count) {
+        _TPCircularBufferAdvanceHead(&buffer_, (TPCircularBufferLength)(count * sizeof(T)), Atomicity::atomic);
+    }
+
+    /*!
+     * Construct an element in the buffer, if there's space
+     *
+     * @param args Arguments for T's constructor
+     * @return true if the element was added, false if the buffer is full
+     */
+    template <typename... Args>
+    bool try_emplace(Args &&...args) {
+        size_t count;
+        T *ptr = head(count);
+        if ( !ptr ) return false;
+        new (ptr) T(std::forward<Args>(args)...);
+        produce(1);
+        return true;
+    }
+
+    /*!
+     * Construct an element in the buffer, waiting for space
+     *
+     *  Waits with the wait policy until the consumer frees up space, so only use this
+     *  where the consumer is sure to keep up, and never on a realtime thread or with
+     *  the consumer on the same thread.
+     *
+     * @param args Arguments for T's constructor
+     */
+    template <typename... Args>
+    void emplace(Args &&...args) {
+        size_t count;
+        T *ptr;
+        while ( !(ptr = head(count)) ) {
+            WaitPolicy::wait();
+        }
+        new (ptr) T(std::forward<Args>(args)...);
+        produce(1);
+    }
+
+    /*!
+     * Add elements to the buffer
+     *
+     *  Copies as many of the given elements as there's space for, and publishes them
+     *  with a single update. Pass std::make_move_iterator(items) to move them instead.
+     *
+     * @param first Iterator to the first element to add
+     * @param count Number of elements to add
+     * @return Number of elements added, which is fewer than count if the buffer filled up
+     */
+    template <typename InputIterator>
+    size_t push(InputIterator first, size_t count) {
+        size_t space;
+        T *ptr = head(space, count);
+        if ( !ptr ) return 0;
+        if ( count > space ) count = space;
+        Producer producer(this); // Publishes what was constructed, even if a constructor throws
+        for ( ; producer.count < count; ++producer.count, ++first ) {
+            new (ptr + producer.count) T(*first);
+        }
+        return count;
+    }
+
+#if defined(__cpp_lib_span)
+    /*!
+     * Move elements into the buffer
+     *
+     * @param items Elements to move from
+     * @return Number of elements added, which is fewer than items.size() if the buffer filled up
+     */
+    size_t push(std::span<T> items) {
+        return push(std::make_move_iterator(items.data()), items.size());
+    }
+#endif
+
+#pragma mark - Reading (consuming)
+
+    /*!
+     * Access end of buffer
+     *
+     *  This gives you a pointer to the oldest element, which is followed by
+     *  the other available elements, to use them in place, then consume.
+     *
+     * @param count On output, the number of elements ready for reading
+     * @return Pointer to the first element, or NULL if buffer is empty
+     */
+    T *tail(size_t &count) {
+        TPCircularBufferLength available;
+        void *ptr = _TPCircularBufferTail(&buffer_, &available, Atomicity::atomic);
+        count = (size_t)available / sizeof(T);
+        return (T *)ptr;
+    }
+
+    /*!
+     * Consume elements
+     *
+     *  Destroys the given number of elements at tail, and frees up their space.
+     *
+     * @param count Number of elements to consume
+     */
+    void consume(size_t count) {
+        Consumer consumer(this);
+        T *ptr = (T *)((char *)buffer_.buffer + buffer_.tail);
+        for ( ; consumer.count < count; ++consumer.count ) {
+            ptr[consumer.count].~T();
+        }
+    }
+
+    /*!
+     * Access the oldest element
+     *
+     * @return Pointer to the oldest element, or NULL if buffer is empty
+     */
+    T *front() {
+        size_t count;
+        return tail(count);
+    }
+
+    /*!
+     * Destroy the oldest element
+     *
+     *  The buffer mustn't be empty.
+     */
+    void pop() {
+        consume(1);
+    }
+
+    /*!
+     * Move elements out of the buffer
+     *
+     *  Moves as many elements as are available, up to count, into the given array,
+     *  destroys them in the buffer, and frees up their space with a single update.
+     *
+     * @param items Array to move elements to
+     * @param count Maximum number of elements to take
+     * @return Number of elements taken
+     */
+    size_t pop(T *items, size_t count) {
+        size_t available;
+        T *ptr = tail(available);
+        if ( !ptr ) return 0;
+        if ( count > available ) count = available;
+        Consumer consumer(this); // Frees what was moved out, even if an assignment throws
+        for ( ; consumer.count < count; ++consumer.count ) {
+            items[consumer.count] = std::move(ptr[consumer.count]);
+            ptr[consumer.count].~T();
+        }
+        return count;
+    }
+
+#if defined(__cpp_lib_span)
+    /*!
+     * Move elements out of the buffer
+     *
+     * @param items Elements to move to
+     * @return Number of elements taken
+     */
+    size_t pop(std::span<T> items) {
+        return pop(items.data(), items.size());
+    }
+#endif
+
+private:
+    struct Producer {
+        TPTypedCircularBuffer *owner;
+        size_t count;
+        explicit Producer(TPTypedCircularBuffer *owner) : owner(owner), count(0) {}
+        ~Producer() { if ( count > 0 ) owner->produce(count); }
+    };
+
+    struct Consumer {
+        TPTypedCircularBuffer *owner;
+        size_t count;
+        explicit Consumer(TPTypedCircularBuffer *owner) : owner(owner), count(0) {}
+        ~Consumer() {
+            if ( count > 0 ) {
+                _TPCircularBufferAdvanceTail(&owner->buffer_, (TPCircularBufferLength)(count * sizeof(T)), Atomicity::atomic);
+            }
+        }
+    };
+
+    TPCircularBuffer buffer_;
+};
+
+#endif
+
+#endif
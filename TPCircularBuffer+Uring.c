@@ -0,0 +1,375 @@
+//
+//  TPCircularBuffer+Uring.c
+//  Circular/Ring buffer implementation
+//
+//  https://github.com/michaeltyson/TPCircularBuffer
+//
+//  Copyright (C) 2012-2013 A Tasty Pixel
+//
+//  This software is provided 'as-is', without any express or implied
+//  warranty.  In no event will the authors be held liable for any damages
+//  arising from the use of this software.
+//
+//  Permission is granted to anyone to use this software for any purpose,
+//  including commercial applications, and to alter it and redistribute it
+//  freely, subject to the following restrictions:
+//
+//  1. The origin of this software must not be misrepresented; you must not
+//     claim that you wrote the original software. If you use this software
+//     in a product, an acknowledgment in the product documentation would be
+//     appreciated but is not required.
+//
+//  2. Altered source versions must be plainly marked as such, and must not be
+//     misrepresented as being the original software.
+//
+//  3. This notice may not be removed or altered from any source distribution.
+//
+
+#if defined(__linux__) && !defined(_GNU_SOURCE)
+#define _GNU_SOURCE // For syscall and MAP_POPULATE
+#endif
+
+#include "TPCircularBuffer+Uring.h"
+
+#if TPCIRCULARBUFFER_HAS_URING
+
+#include <stdlib.h>
+#include <errno.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <linux/io_uring.h>
+
+#ifndef __NR_io_uring_setup
+#define __NR_io_uring_setup 425
+#endif
+#ifndef __NR_io_uring_enter
+#define __NR_io_uring_enter 426
+#endif
+
+typedef struct {
+    char     *bytes;
+    int32_t   length;
+    int32_t   transferred;
+    int64_t   fileOffset;       // Or -1 for streams
+    int       fileDescriptor;
+    int       error;
+    bool      complete;
+} TPCircularBufferUringBlock;
+
+struct TPCircularBufferUring {
+    TPCircularBuffer               *buffer;
+    TPCircularBufferUringDirection  direction;
+    int                             ringFileDescriptor;
+
+    // Submission queue, shared with the kernel
+    void                           *submissionRing;
+    size_t                          submissionRingLength;
+    atomic_uint                    *submissionTail;
+    uint32_t                        submissionMask;
+    uint32_t                       *submissionArray;
+    struct io_uring_sqe            *submissionEntries;
+    size_t                          submissionEntriesLength;
+    uint32_t                        unsubmittedEntries;
+
+    // Completion queue, shared with the kernel
+    void                           *completionRing;
+    size_t                          completionRingLength;
+    atomic_uint                    *completionHead;
+    atomic_uint                    *completionTail;
+    uint32_t                        completionMask;
+    struct io_uring_cqe            *completionEntries;
+
+    // Blocks in flight, indexed by sequence number modulo the queue depth
+    TPCircularBufferUringBlock     *blocks;
+    uint32_t                        queueDepth;
+    uint32_t                        firstBlock;         // Sequence number of the oldest block in flight
+    uint32_t                        nextBlock;          // Sequence number of the next block to submit
+    _TPCircularBufferPosition       reservedEnd;        // Position after the last block reserved
+    _TPCircularBufferPosition       committedEnd;       // Position after the last block committed
+    TPCircularBufferLength          shortfall;          // How far short committed reads fell, since the last time none were in flight
+    bool                            endOfFile;
+};
+
+#pragma mark - Kernel interface
+
+static void releaseResources(TPCircularBufferUring *uring) {
+    if ( uring->submissionEntries ) munmap(uring->submissionEntries, uring->submissionEntriesLength);
+    if ( uring->completionRing ) munmap(uring->completionRing, uring->completionRingLength);
+    if ( uring->submissionRing ) munmap(uring->submissionRing, uring->submissionRingLength);
+    if ( uring->ringFileDescriptor >= 0 ) close(uring->ringFileDescriptor);
+    free(uring->blocks);
+    free(uring);
+}
+
+static void *mapRing(int ringFileDescriptor, size_t length, off_t offset) {
+    void *ring = mmap(NULL, length, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ringFileDescriptor, offset);
+    return ring == MAP_FAILED ? NULL : ring;
+}
+
+/*!
+ * Submit queued entries, and optionally wait for completions
+ */
+static int enterRing(TPCircularBufferUring *uring, uint32_t minCompletions) {
+    while ( true ) {
+        long result = syscall(__NR_io_uring_enter,
+                              uring->ringFileDescriptor,
+                              uring->unsubmittedEntries,
+                              minCompletions,
+                              minCompletions ? IORING_ENTER_GETEVENTS : 0,
+                              NULL,
+                              0);
+        if ( result >= 0 ) {
+            uring->unsubmittedEntries -= (uint32_t)result;
+            return 0;
+        }
+        if ( errno != EINTR ) {
+            return -1;
+        }
+    }
+}
+
+/*!
+ * Queue a request for the rest of a block
+ */
+static void queueBlock(TPCircularBufferUring *uring, const TPCircularBufferUringBlock *block, uint32_t sequence) {
+    uint32_t tail = atomic_load_explicit(uring->submissionTail, memory_order_relaxed);
+    uint32_t index = tail & uring->submissionMask;
+    struct io_uring_sqe *entry = &uring->submissionEntries[index];
+    memset(entry, 0, sizeof(*entry));
+    entry->opcode = uring->direction == kTPCircularBufferUringRead ? IORING_OP_READ : IORING_OP_WRITE;
+    entry->fd = block->fileDescriptor;
+    entry->addr = (uint64_t)(uintptr_t)(block->bytes + block->transferred);
+    entry->len = (uint32_t)(block->length - block->transferred);
+    entry->off = block->fileOffset < 0 ? (uint64_t)-1 : (uint64_t)(block->fileOffset + block->transferred);
+    entry->user_data = sequence;
+    uring->submissionArray[index] = index;
+    atomic_store_explicit(uring->submissionTail, tail + 1, memory_order_release);
+    uring->unsubmittedEntries++;
+}
+
+#pragma mark - Public interface
+
+TPCircularBufferUring *TPCircularBufferUringCreate(TPCircularBuffer *buffer,
+                                                   TPCircularBufferUringDirection direction,
+                                                   int queueDepth) {
+    assert(queueDepth > 0);
+
+    TPCircularBufferUring *uring = (TPCircularBufferUring *)calloc(1, sizeof(TPCircularBufferUring));
+    if ( !uring ) return NULL;
+    uring->ringFileDescriptor = -1;
+    uring->buffer = buffer;
+    uring->direction = direction;
+    uring->queueDepth = (uint32_t)queueDepth;
+    uring->blocks = (TPCircularBufferUringBlock *)calloc((size_t)queueDepth, sizeof(TPCircularBufferUringBlock));
+    if ( !uring->blocks ) {
+        releaseResources(uring);
+        return NULL;
+    }
+
+    struct io_uring_params params;
+    memset(&params, 0, sizeof(params));
+    uring->ringFileDescriptor = (int)syscall(__NR_io_uring_setup, (unsigned int)queueDepth, &params);
+    if ( uring->ringFileDescriptor < 0 ) {
+        int error = errno;
+        releaseResources(uring);
+        errno = error;
+        return NULL;
+    }
+
+    uring->submissionRingLength = params.sq_off.array + params.sq_entries * sizeof(uint32_t);
+    uring->completionRingLength = params.cq_off.cqes + params.cq_entries * sizeof(struct io_uring_cqe);
+    uring->submissionEntriesLength = params.sq_entries * sizeof(struct io_uring_sqe);
+    uring->submissionRing = mapRing(uring->ringFileDescriptor, uring->submissionRingLength, IORING_OFF_SQ_RING);
+    uring->completionRing = mapRing(uring->ringFileDescriptor, uring->completionRingLength, IORING_OFF_CQ_RING);
+    uring->submissionEntries = (struct io_uring_sqe *)mapRing(uring->ringFileDescriptor, uring->submissionEntriesLength, IORING_OFF_SQES);
+    if ( !uring->submissionRing || !uring->completionRing || !uring->submissionEntries ) {
+        int error = errno;
+        releaseResources(uring);
+        errno = error;
+        return NULL;
+    }
+
+    char *submissionRing = (char *)uring->submissionRing;
+    uring->submissionTail = (atomic_uint *)(submissionRing + params.sq_off.tail);
+    uring->submissionMask = *(uint32_t *)(submissionRing + params.sq_off.ring_mask);
+    uring->submissionArray = (uint32_t *)(submissionRing + params.sq_off.array);
+
+    char *completionRing = (char *)uring->completionRing;
+    uring->completionHead = (atomic_uint *)(completionRing + params.cq_off.head);
+    uring->completionTail = (atomic_uint *)(completionRing + params.cq_off.tail);
+    uring->completionMask = *(uint32_t *)(completionRing + params.cq_off.ring_mask);
+    uring->completionEntries = (struct io_uring_cqe *)(completionRing + params.cq_off.cqes);
+
+    return uring;
+}
+
+void TPCircularBufferUringDestroy(TPCircularBufferUring *uring) {
+    // The kernel may still be transferring to or from the buffer, so wait for it to finish
+    while ( uring->firstBlock != uring->nextBlock ) {
+        uint32_t firstBlock = uring->firstBlock;
+        int error;
+        if ( TPCircularBufferUringComplete(uring, 1, &error) == 0 && uring->firstBlock == firstBlock && error ) {
+            break;
+        }
+    }
+    releaseResources(uring);
+}
+
+int TPCircularBufferUringSubmit(TPCircularBufferUring *uring,
+                                int fileDescriptor,
+                                int64_t *fileOffset,
+                                int32_t blockLength,
+                                int maxBlocks) {
+    TPCircularBuffer *buffer = uring->buffer;
+    assert(blockLength > 0 && blockLength <= buffer->length);
+
+    TPCircularBufferLength available;
+    char *bytes;
+    if ( uring->direction == kTPCircularBufferUringRead ) {
+#if TPCIRCULARBUFFER_CACHED_INDICES
+        _TPCircularBufferProducerFillCount(buffer, _TPCircularBufferAtomic(buffer), true);
+#endif
+        TPCircularBufferLength discard;
+        bytes = (char *)TPCircularBufferHead(buffer, &available, &discard);
+    } else {
+#if TPCIRCULARBUFFER_CACHED_INDICES
+        buffer->cachedHeadPosition = (_TPCircularBufferAtomic(buffer) ?
+                                      atomic_load_explicit(&buffer->headPosition, memory_order_acquire) :
+                                      atomic_load_explicit(&buffer->headPosition, memory_order_relaxed));
+#endif
+        bytes = (char *)TPCircularBufferTail(buffer, &available);
+    }
+    if ( !bytes ) return 0;
+
+    // Blocks already in flight come first
+    TPCircularBufferLength reserved = (TPCircularBufferLength)(uring->reservedEnd - uring->committedEnd) + uring->shortfall;
+    available -= reserved;
+    bytes += reserved;
+
+    int inFlight = (int)(uring->nextBlock - uring->firstBlock);
+    TPCircularBufferLength blocks = uring->direction == kTPCircularBufferUringRead
+        ? available / blockLength
+        : (available + blockLength - 1) / blockLength;
+    int count = blocks < maxBlocks ? (int)blocks : maxBlocks;
+    if ( count > (int)uring->queueDepth - inFlight ) count = (int)uring->queueDepth - inFlight;
+    if ( !fileOffset && count > 0 ) {
+        // Requests on a stream may be carried out in any order, so only have one at a time
+        count = inFlight == 0 ? 1 : 0;
+    }
+
+    for ( int i=0; i<count; i++ ) {
+        uint32_t sequence = uring->nextBlock++;
+        TPCircularBufferUringBlock *block = &uring->blocks[sequence % uring->queueDepth];
+        block->bytes = bytes;
+        block->length = available < blockLength ? (int32_t)available : blockLength;
+        block->transferred = 0;
+        block->fileOffset = fileOffset ? *fileOffset : -1;
+        block->fileDescriptor = fileDescriptor;
+        block->error = 0;
+        block->complete = false;
+        if ( fileOffset ) *fileOffset += block->length;
+        uring->reservedEnd += (_TPCircularBufferPosition)block->length;
+        bytes += block->length;
+        available -= block->length;
+        queueBlock(uring, block, sequence);
+    }
+
+    if ( uring->unsubmittedEntries > 0 && enterRing(uring, 0) != 0 ) {
+        return -1;
+    }
+    return count;
+}
+
+TPCircularBufferLength TPCircularBufferUringComplete(TPCircularBufferUring *uring, int minCompletions, int *error) {
+    TPCircularBuffer *buffer = uring->buffer;
+    if ( error ) *error = 0;
+
+    int inFlight = (int)(uring->nextBlock - uring->firstBlock);
+    if ( minCompletions > inFlight ) minCompletions = inFlight;
+    if ( (uring->unsubmittedEntries > 0 || minCompletions > 0) && enterRing(uring, (uint32_t)minCompletions) != 0 ) {
+        if ( error ) *error = errno;
+        return 0;
+    }
+
+    // Collect completions
+    uint32_t head = atomic_load_explicit(uring->completionHead, memory_order_relaxed);
+    uint32_t tail = atomic_load_explicit(uring->completionTail, memory_order_acquire);
+    for ( ; head != tail; head++ ) {
+        const struct io_uring_cqe *entry = &uring->completionEntries[head & uring->completionMask];
+        uint32_t sequence = (uint32_t)entry->user_data;
+        TPCircularBufferUringBlock *block = &uring->blocks[sequence % uring->queueDepth];
+        if ( entry->res < 0 ) {
+            block->error = -entry->res;
+            block->complete = true;
+        } else if ( entry->res == 0 ) {
+            if ( uring->direction == kTPCircularBufferUringRead ) {
+                uring->endOfFile = true;
+            } else {
+                block->error = EIO;
+            }
+            block->complete = true;
+        } else {
+            block->transferred += entry->res;
+            if ( block->transferred < block->length
+                    && (block->fileOffset >= 0 || uring->direction == kTPCircularBufferUringWrite) ) {
+                // Short transfer: request the rest
+                queueBlock(uring, block, sequence);
+            } else {
+                block->complete = true;
+            }
+        }
+    }
+    atomic_store_explicit(uring->completionHead, head, memory_order_release);
+
+    // Commit, in order, each complete block with nothing incomplete before it
+    TPCircularBufferLength committed = 0;
+    while ( uring->firstBlock != uring->nextBlock ) {
+        TPCircularBufferUringBlock *block = &uring->blocks[uring->firstBlock % uring->queueDepth];
+        if ( !block->complete ) break;
+        if ( uring->direction == kTPCircularBufferUringRead ) {
+            if ( block->transferred > 0 ) {
+                if ( uring->shortfall > 0 ) {
+                    // An earlier block came up short; move this one back to close the gap
+                    char *head = (char *)buffer->buffer + buffer->head;
+                    memmove(head, head + uring->shortfall, (size_t)block->transferred);
+                }
+                TPCircularBufferProduce(buffer, block->transferred);
+                committed += block->transferred;
+            }
+            uring->shortfall += block->length - block->transferred;
+        } else {
+            TPCircularBufferConsume(buffer, block->length);
+            committed += block->length;
+        }
+        if ( block->error && error && !*error ) {
+            *error = block->error;
+        }
+        uring->committedEnd += (_TPCircularBufferPosition)block->length;
+        uring->firstBlock++;
+    }
+
+    if ( uring->firstBlock == uring->nextBlock && uring->shortfall > 0 ) {
+        // Nothing's in flight, so reservations can start from the front of the buffer again
+        uring->committedEnd -= (_TPCircularBufferPosition)uring->shortfall;
+        uring->reservedEnd = uring->committedEnd;
+        uring->shortfall = 0;
+    }
+
+    // Send any requests for the rest of short transfers
+    if ( uring->unsubmittedEntries > 0 && enterRing(uring, 0) != 0 && error && !*error ) {
+        *error = errno;
+    }
+
+    return committed;
+}
+
+int TPCircularBufferUringBlocksInFlight(const TPCircularBufferUring *uring) {
+    return (int)(uring->nextBlock - uring->firstBlock);
+}
+
+bool TPCircularBufferUringAtEndOfFile(const TPCircularBufferUring *uring) {
+    return uring->endOfFile;
+}
+
+#endif
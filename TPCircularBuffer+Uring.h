@@ -0,0 +1,158 @@
+//
+//  TPCircularBuffer+Uring.h
+//  Circular/Ring buffer implementation
+//
+//  https://github.com/michaeltyson/TPCircularBuffer
+//
+//  An io_uring engine that keeps several reads into, or writes from, the buffer in
+//  flight at once. It reserves consecutive blocks of the buffer and submits one
+//  request per block with a single system call. As completions arrive, in any order,
+//  it produces (for reads) or consumes (for writes) the blocks strictly in order, so
+//  the other side of the buffer sees an ordinary stream of bytes.
+//
+//  Each engine is the buffer's producer (reading into the buffer) or its consumer
+//  (writing from it), and belongs to that side's thread. Use one of each, on their
+//  own threads, to read from one file and write to another through the buffer.
+//
+//  Regular files are read and written at explicit offsets, so many blocks may be in
+//  flight. For streams such as pipes and sockets, which have no offsets, one block is
+//  in flight at a time.
+//
+//  Linux only. The engine talks to the kernel directly, so liburing isn't needed.
+//
+//  Copyright (C) 2012-2013 A Tasty Pixel
+//
+//  This software is provided 'as-is', without any express or implied
+//  warranty.  In no event will the authors be held liable for any damages
+//  arising from the use of this software.
+//
+//  Permission is granted to anyone to use this software for any purpose,
+//  including commercial applications, and to alter it and redistribute it
+//  freely, subject to the following restrictions:
+//
+//  1. The origin of this software must not be misrepresented; you must not
+//     claim that you wrote the original software. If you use this software
+//     in a product, an acknowledgment in the product documentation would be
+//     appreciated but is not required.
+//
+//  2. Altered source versions must be plainly marked as such, and must not be
+//     misrepresented as being the original software.
+//
+//  3. This notice may not be removed or altered from any source distribution.
+//
+
+#ifndef TPCircularBuffer_Uring_h
+#define TPCircularBuffer_Uring_h
+
+#include "TPCircularBuffer.h"
+
+#if defined(__linux__) && defined(__has_include)
+    #if __has_include(<linux/io_uring.h>)
+        #define TPCIRCULARBUFFER_HAS_URING 1
+    #endif
+#endif
+#ifndef TPCIRCULARBUFFER_HAS_URING
+    #define TPCIRCULARBUFFER_HAS_URING 0
+#endif
+
+#if TPCIRCULARBUFFER_HAS_URING
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef enum {
+    kTPCircularBufferUringRead,     // Read from files into the buffer, as its producer
+    kTPCircularBufferUringWrite,    // Write from the buffer to files, as its consumer
+} TPCircularBufferUringDirection;
+
+typedef struct TPCircularBufferUring TPCircularBufferUring;
+
+/*!
+ * Create an engine
+ *
+ * @param buffer Circular buffer
+ * @param direction Whether the engine reads into the buffer, or writes from it
+ * @param queueDepth Maximum number of blocks in flight
+ * @return The engine, or NULL on error (with errno set, e.g. ENOSYS if io_uring isn't available)
+ */
+TPCircularBufferUring *TPCircularBufferUringCreate(TPCircularBuffer *buffer,
+                                                   TPCircularBufferUringDirection direction,
+                                                   int queueDepth);
+
+/*!
+ * Destroy an engine
+ *
+ *  Waits for any blocks still in flight, committing them as usual, then releases
+ *  the engine's resources.
+ *
+ * @param uring The engine
+ */
+void TPCircularBufferUringDestroy(TPCircularBufferUring *uring);
+
+/*!
+ * Submit blocks
+ *
+ *  Reserves up to maxBlocks consecutive blocks, after any already in flight, and
+ *  submits a read into (or a write from) each, with a single system call. For
+ *  reads, blocks are taken from the free space at the front of the buffer; for
+ *  writes, from the bytes available at the end, the last block being shorter if
+ *  fewer than blockLength bytes remain.
+ *
+ * @param uring The engine
+ * @param fileDescriptor File to read from or write to
+ * @param fileOffset Offset in the file of the first block, advanced past the blocks submitted; or NULL for streams
+ * @param blockLength Length of each block
+ * @param maxBlocks Maximum number of blocks to submit
+ * @return Number of blocks submitted, or -1 on error (with errno set)
+ */
+int TPCircularBufferUringSubmit(TPCircularBufferUring *uring,
+                                int fileDescriptor,
+                                int64_t *fileOffset,
+                                int32_t blockLength,
+                                int maxBlocks);
+
+/*!
+ * Process completions
+ *
+ *  Collects completed blocks, waiting until at least minCompletions have completed,
+ *  and commits every block that's complete and has no incomplete block before it:
+ *  produced, for reads, or consumed, for writes.
+ *
+ *  Short transfers on regular files are resubmitted for the remainder. A read that
+ *  reaches the end of the file is committed with what it read, and marks the engine
+ *  as at end of file. A block that fails is committed with what it transferred (for
+ *  writes, the rest of its bytes are lost), and its error is reported.
+ *
+ * @param uring The engine
+ * @param minCompletions Number of completions to wait for, or 0 not to wait
+ * @param error If not NULL, on output, the errno of the first failed block, or 0
+ * @return Number of bytes committed
+ */
+TPCircularBufferLength TPCircularBufferUringComplete(TPCircularBufferUring *uring, int minCompletions, int *error);
+
+/*!
+ * Number of blocks in flight
+ *
+ *  Includes completed blocks waiting on earlier ones before they can be committed.
+ *
+ * @param uring The engine
+ * @return Number of blocks submitted and not yet committed
+ */
+int TPCircularBufferUringBlocksInFlight(const TPCircularBufferUring *uring);
+
+/*!
+ * Whether a read has reached the end of the file
+ *
+ * @param uring The engine
+ * @return true once a read returns no bytes
+ */
+bool TPCircularBufferUringAtEndOfFile(const TPCircularBufferUring *uring);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
+
+#endif
@@ -0,0 +1,207 @@
+//
+//  TPCircularBuffer+Wait.c
+//  Circular/Ring buffer implementation
+//
+//  https://github.com/michaeltyson/TPCircularBuffer
+//
+//  Copyright (C) 2012-2013 A Tasty Pixel
+//
+//  This software is provided 'as-is', without any express or implied
+//  warranty.  In no event will the authors be held liable for any damages
+//  arising from the use of this software.
+//
+//  Permission is granted to anyone to use this software for any purpose,
+//  including commercial applications, and to alter it and redistribute it
+//  freely, subject to the following restrictions:
+//
+//  1. The origin of this software must not be misrepresented; you must not
+//     claim that you wrote the original software. If you use this software
+//     in a product, an acknowledgment in the product documentation would be
+//     appreciated but is not required.
+//
+//  2. Altered source versions must be plainly marked as such, and must not be
+//     misrepresented as being the original software.
+//
+//  3. This notice may not be removed or altered from any source distribution.
+//
+
+#if defined(__linux__) && !defined(_GNU_SOURCE)
+#define _GNU_SOURCE // For syscall and CLOCK_MONOTONIC
+#endif
+
+#include "TPCircularBuffer+Wait.h"
+
+#include <errno.h>
+#include <limits.h>
+#include <time.h>
+
+#if defined(__linux__)
+#include <unistd.h>
+#include <sys/syscall.h>
+#include <linux/futex.h>
+#else
+static const long kPollInterval = 100000; // Nanoseconds between polls, where there's no futex
+#endif
+
+#pragma mark - Waiting primitives
+
+static void deadlineAfter(int64_t timeoutNanoseconds, struct timespec *deadline) {
+    clock_gettime(CLOCK_MONOTONIC, deadline);
+    int64_t nanoseconds = (int64_t)deadline->tv_nsec + timeoutNanoseconds % 1000000000;
+    deadline->tv_sec += (time_t)(timeoutNanoseconds / 1000000000 + nanoseconds / 1000000000);
+    deadline->tv_nsec = (long)(nanoseconds % 1000000000);
+}
+
+/*!
+ * Sleep while *word still holds value, until woken or the deadline passes
+ *
+ * @return false if the deadline passed, true otherwise
+ */
+static bool waitOnWord(void *word, uint32_t value, const struct timespec *deadline) {
+#if defined(__linux__)
+    // FUTEX_WAIT_BITSET takes an absolute CLOCK_MONOTONIC deadline, which survives spurious wakeups.
+    // Not the _PRIVATE variant, so that waits work on buffers shared between processes.
+    long result = syscall(SYS_futex, (uint32_t *)word, FUTEX_WAIT_BITSET, value,
+                          deadline, NULL, FUTEX_BITSET_MATCH_ANY);
+    return !(result == -1 && errno == ETIMEDOUT);
+#else
+    (void)word;
+    (void)value;
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    long interval = kPollInterval;
+    if ( deadline ) {
+        if ( now.tv_sec > deadline->tv_sec || (now.tv_sec == deadline->tv_sec && now.tv_nsec >= deadline->tv_nsec) ) {
+            return false;
+        }
+        int64_t remaining = (int64_t)(deadline->tv_sec - now.tv_sec) * 1000000000 + (deadline->tv_nsec - now.tv_nsec);
+        if ( remaining < interval ) interval = (long)remaining;
+    }
+    struct timespec sleep = { 0, interval };
+    nanosleep(&sleep, NULL);
+    return true;
+#endif
+}
+
+static void wakeWord(void *word) {
+#if defined(__linux__)
+    syscall(SYS_futex, (uint32_t *)word, FUTEX_WAKE, INT_MAX, NULL, NULL, 0);
+#else
+    (void)word; // Waiters poll
+#endif
+}
+
+#pragma mark - Buffer state
+
+/*!
+ * The 32 bits of a position or fill count to sleep on
+ *
+ *  Futexes are 32 bits, so with TPCIRCULARBUFFER_64BIT_LENGTHS, sleep on the low half,
+ *  which changes with every produce or consume that isn't a multiple of 4 GiB.
+ */
+static inline void *lowWord(void *word) {
+#if TPCIRCULARBUFFER_64BIT_LENGTHS && defined(__BYTE_ORDER__) && __BYTE_ORDER__ == __ORDER_BIG_ENDIAN__
+    return (char *)word + sizeof(uint32_t);
+#else
+    return word;
+#endif
+}
+
+// The word a thread waiting for bytes sleeps on, which changes whenever bytes are produced
+static inline void *bytesWord(TPCircularBuffer *buffer) {
+#if TPCIRCULARBUFFER_CACHED_INDICES
+    return lowWord(&buffer->headPosition);
+#else
+    return lowWord(&buffer->fillCount);
+#endif
+}
+
+// The word a thread waiting for space sleeps on, which changes whenever bytes are consumed
+static inline void *spaceWord(TPCircularBuffer *buffer) {
+#if TPCIRCULARBUFFER_CACHED_INDICES
+    return lowWord(&buffer->tailPosition);
+#else
+    return lowWord(&buffer->fillCount);
+#endif
+}
+
+static TPCircularBufferLength availableBytes(TPCircularBuffer *buffer, uint32_t *wordValue) {
+#if TPCIRCULARBUFFER_CACHED_INDICES
+    _TPCircularBufferPosition headPosition = atomic_load_explicit(&buffer->headPosition, memory_order_acquire);
+    buffer->cachedHeadPosition = headPosition;
+    *wordValue = (uint32_t)headPosition;
+    TPCircularBufferLength fillCount =
+        (TPCircularBufferLength)(headPosition - atomic_load_explicit(&buffer->tailPosition, memory_order_relaxed));
+#else
+    TPCircularBufferLength fillCount = atomic_load_explicit(&buffer->fillCount, memory_order_acquire);
+    *wordValue = (uint32_t)fillCount;
+#endif
+    return fillCount > 0 ? fillCount : 0;
+}
+
+static TPCircularBufferLength availableSpace(TPCircularBuffer *buffer, uint32_t *wordValue) {
+#if TPCIRCULARBUFFER_CACHED_INDICES
+    _TPCircularBufferPosition tailPosition = atomic_load_explicit(&buffer->tailPosition, memory_order_acquire);
+    buffer->cachedTailPosition = tailPosition;
+    *wordValue = (uint32_t)tailPosition;
+    TPCircularBufferLength fillCount =
+        (TPCircularBufferLength)(atomic_load_explicit(&buffer->headPosition, memory_order_relaxed) - tailPosition);
+#else
+    TPCircularBufferLength fillCount = atomic_load_explicit(&buffer->fillCount, memory_order_acquire);
+    *wordValue = (uint32_t)fillCount;
+#endif
+    return buffer->length - (fillCount > 0 ? fillCount : 0);
+}
+
+static bool waitFor(TPCircularBuffer *buffer,
+                    TPCircularBufferLength minimumBytes,
+                    int64_t timeoutNanoseconds,
+                    TPCircularBufferLength (*available)(TPCircularBuffer *, uint32_t *),
+                    void *word,
+                    atomic_int *waiters) {
+    uint32_t value;
+    if ( available(buffer, &value) >= minimumBytes ) return true;
+
+    struct timespec deadline;
+    if ( timeoutNanoseconds >= 0 ) {
+        deadlineAfter(timeoutNanoseconds, &deadline);
+    }
+
+    // Register before checking again, so the other side either sees us or we see its update
+    atomic_fetch_add_explicit(waiters, 1, memory_order_seq_cst);
+
+    bool result;
+    while ( true ) {
+        if ( available(buffer, &value) >= minimumBytes ) {
+            result = true;
+            break;
+        }
+        if ( !waitOnWord(word, value, timeoutNanoseconds >= 0 ? &deadline : NULL) ) {
+            result = available(buffer, &value) >= minimumBytes;
+            break;
+        }
+    }
+
+    atomic_fetch_sub_explicit(waiters, 1, memory_order_relaxed);
+    return result;
+}
+
+#pragma mark - Public interface
+
+bool TPCircularBufferWaitForBytes(TPCircularBuffer *buffer, TPCircularBufferLength minimumBytes, int64_t timeoutNanoseconds) {
+    assert(minimumBytes <= buffer->length);
+    return waitFor(buffer, minimumBytes, timeoutNanoseconds, availableBytes, bytesWord(buffer), &buffer->bytesWaiters);
+}
+
+bool TPCircularBufferWaitForSpace(TPCircularBuffer *buffer, TPCircularBufferLength minimumBytes, int64_t timeoutNanoseconds) {
+    assert(minimumBytes <= buffer->length);
+    return waitFor(buffer, minimumBytes, timeoutNanoseconds, availableSpace, spaceWord(buffer), &buffer->spaceWaiters);
+}
+
+void _TPCircularBufferWakeBytesWaiters(TPCircularBuffer *buffer) {
+    wakeWord(bytesWord(buffer));
+}
+
+void _TPCircularBufferWakeSpaceWaiters(TPCircularBuffer *buffer) {
+    wakeWord(spaceWord(buffer));
+}
@@ -0,0 +1,147 @@
+//
+//  TPCircularBuffer+Wait.h
+//  Circular/Ring buffer implementation
+//
+//  https://github.com/michaeltyson/TPCircularBuffer
+//
+//  Blocking waits for non-realtime producers and consumers, so they needn't spin or
+//  poll while the buffer is empty or full. On Linux, waiting threads sleep on a futex
+//  keyed on the buffer's fill count (or, with TPCIRCULARBUFFER_CACHED_INDICES, on the
+//  other side's position), which also works for buffers shared between processes with
+//  TPCircularBuffer+Shared; elsewhere they poll with short sleeps.
+//
+//  The other side must use the "AndNotify" variants of Produce and Consume for waiting
+//  threads to be woken promptly. These only make a system call when a thread is actually
+//  waiting, and the plain TPCircularBufferProduce and TPCircularBufferConsume are
+//  unaffected, so realtime threads can keep using those.
+//
+//  Copyright (C) 2012-2013 A Tasty Pixel
+//
+//  This software is provided 'as-is', without any express or implied
+//  warranty.  In no event will the authors be held liable for any damages
+//  arising from the use of this software.
+//
+//  Permission is granted to anyone to use this software for any purpose,
+//  including commercial applications, and to alter it and redistribute it
+//  freely, subject to the following restrictions:
+//
+//  1. The origin of this software must not be misrepresented; you must not
+//     claim that you wrote the original software. If you use this software
+//     in a product, an acknowledgment in the product documentation would be
+//     appreciated but is not required.
+//
+//  2. Altered source versions must be plainly marked as such, and must not be
+//     misrepresented as being the original software.
+//
+//  3. This notice may not be removed or altered from any source distribution.
+//
+
+#ifndef TPCircularBuffer_Wait_h
+#define TPCircularBuffer_Wait_h
+
+#include "TPCircularBuffer.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*!
+ * Wait without a timeout
+ */
+#define kTPCircularBufferWaitForever (-1)
+
+/*!
+ * Wait for bytes to read
+ *
+ *  Blocks until at least the given number of bytes are ready for reading, or the
+ *  timeout elapses. Only call this from the consumer thread.
+ *
+ * @param buffer Circular buffer
+ * @param minimumBytes Number of bytes to wait for
+ * @param timeoutNanoseconds Maximum time to wait, or kTPCircularBufferWaitForever
+ * @return true if the bytes are available, false if the wait timed out
+ */
+bool TPCircularBufferWaitForBytes(TPCircularBuffer *buffer, TPCircularBufferLength minimumBytes, int64_t timeoutNanoseconds);
+
+/*!
+ * Wait for space to write
+ *
+ *  Blocks until at least the given number of bytes are free for writing, or the
+ *  timeout elapses. Only call this from the producer thread.
+ *
+ * @param buffer Circular buffer
+ * @param minimumBytes Number of bytes to wait for
+ * @param timeoutNanoseconds Maximum time to wait, or kTPCircularBufferWaitForever
+ * @return true if the space is available, false if the wait timed out
+ */
+bool TPCircularBufferWaitForSpace(TPCircularBuffer *buffer, TPCircularBufferLength minimumBytes, int64_t timeoutNanoseconds);
+
+void _TPCircularBufferWakeBytesWaiters(TPCircularBuffer *buffer);
+void _TPCircularBufferWakeSpaceWaiters(TPCircularBuffer *buffer);
+
+/*!
+ * Produce bytes in buffer, and wake any thread waiting for them
+ *
+ *  Like TPCircularBufferProduce, but also wakes a thread blocked in
+ *  TPCircularBufferWaitForBytes. Doesn't make a system call unless one is waiting.
+ *
+ * @param buffer Circular buffer
+ * @param amount Number of bytes to produce
+ * @return Number of bytes ready for reading before the operation
+ */
+static __inline__ __attribute__((always_inline)) TPCircularBufferLength TPCircularBufferProduceAndNotify(TPCircularBuffer *buffer,
+                                                                                                          TPCircularBufferLength amount) {
+    TPCircularBufferLength previousFillCount = TPCircularBufferProduce(buffer, amount);
+    // Order the produce before checking for waiters; pairs with the waiter's registration
+    atomic_thread_fence(memory_order_seq_cst);
+    if ( atomic_load_explicit(&buffer->bytesWaiters, memory_order_relaxed) > 0 ) {
+        _TPCircularBufferWakeBytesWaiters(buffer);
+    }
+    return previousFillCount;
+}
+
+/*!
+ * Copy bytes to buffer, and wake any thread waiting for them
+ *
+ *  Like TPCircularBufferProduceBytes, but also wakes a thread blocked in
+ *  TPCircularBufferWaitForBytes.
+ *
+ * @param buffer Circular buffer
+ * @param src Source buffer
+ * @param len Number of bytes in source buffer
+ * @return true if bytes copied, false if there was insufficient space
+ */
+static __inline__ __attribute__((always_inline)) bool TPCircularBufferProduceBytesAndNotify(TPCircularBuffer *buffer,
+                                                                                            const void *src,
+                                                                                            TPCircularBufferLength len) {
+    if ( !TPCircularBufferProduceBytes(buffer, src, len) ) return false;
+    atomic_thread_fence(memory_order_seq_cst);
+    if ( atomic_load_explicit(&buffer->bytesWaiters, memory_order_relaxed) > 0 ) {
+        _TPCircularBufferWakeBytesWaiters(buffer);
+    }
+    return true;
+}
+
+/*!
+ * Consume bytes in buffer, and wake any thread waiting for space
+ *
+ *  Like TPCircularBufferConsume, but also wakes a thread blocked in
+ *  TPCircularBufferWaitForSpace. Doesn't make a system call unless one is waiting.
+ *
+ * @param buffer Circular buffer
+ * @param amount Number of bytes to consume
+ */
+static __inline__ __attribute__((always_inline)) void TPCircularBufferConsumeAndNotify(TPCircularBuffer *buffer,
+                                                                                       TPCircularBufferLength amount) {
+    TPCircularBufferConsume(buffer, amount);
+    atomic_thread_fence(memory_order_seq_cst);
+    if ( atomic_load_explicit(&buffer->spaceWaiters, memory_order_relaxed) > 0 ) {
+        _TPCircularBufferWakeSpaceWaiters(buffer);
+    }
+}
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -27,15 +27,43 @@
 //  3. This notice may not be removed or altered from any source distribution.
 //
 
+#if defined(__linux__) && !defined(_GNU_SOURCE)
+#define _GNU_SOURCE // For memfd_create
+#endif
+
 #include "TPCircularBuffer.h"
 
 #include <stdlib.h>
 #include <stdio.h>
+#include <errno.h>
 
+#if defined(__APPLE__)
 #include <mach/mach.h>
+#include <sys/mman.h>
+#else
+#include <unistd.h>
+#include <sys/mman.h>
+#if defined(__linux__)
+#include <sys/syscall.h>
+#include <linux/mempolicy.h>
+#else
+#include <fcntl.h>
+#endif
+#endif
+
+#if defined(__x86_64__)
+#include <immintrin.h>
+#endif
 
 #define reportResult(result, operation) \
-(_reportResult((result), (operation), strrchr(__FILE__, '/') + 1, __LINE__))
+(_reportResult((result), (operation), _fileName(__FILE__), __LINE__))
+
+static inline const char *_fileName(const char *path) {
+    const char *slash = strrchr(path, '/');
+    return slash ? slash + 1 : path;
+}
+
+#if defined(__APPLE__)
 static inline bool _reportResult(kern_return_t result, const char *operation, const char *file, int line) {
     if ( result != ERR_SUCCESS ) {
         fprintf(stderr, "%s:%d: %s: %s.\n", file, line, operation, mach_error_string(result));
@@ -43,28 +71,36 @@ static inline bool _reportResult(kern_return_t result, const char *operation, co
     }
     return true;
 }
+#else
+static inline bool _reportResult(int result, const char *operation, const char *file, int line) {
+    if ( result != 0 ) {
+        fprintf(stderr, "%s:%d: %s: %s.\n", file, line, operation, strerror(result));
+        return false;
+    }
+    return true;
+}
+#endif
 
-bool _TPCircularBufferInit(TPCircularBuffer *buffer, int32_t length, size_t structSize) {
-    assert(length > 0);
+#if defined(__APPLE__)
+static bool _TPCircularBufferMapMemory(TPCircularBuffer *buffer, TPCircularBufferLength length, TPCircularBufferOptions options) {
+    (void)options; // Huge pages can't be mirrored with vm_remap, so always use normal pages
     
-    if ( structSize != sizeof(TPCircularBuffer) ) {
-        fprintf(stderr,
-                "TPCircularBuffer: Header version mismatch. "
-                "Check for old versions of TPCircularBuffer in your project.\n");
-        abort();
+    if ( (vm_size_t)round_page(length) > (vm_size_t)kTPCircularBufferMaxLength ) {
+        fprintf(stderr, "TPCircularBuffer: Length too large to round up to whole pages.\n");
+        return false;
     }
     
     // Keep trying until we get our buffer, needed to handle race conditions.
     int retries = 3;
     while ( true ) {
-        buffer->length = (int32_t)round_page(length); // We need whole page sizes.
+        buffer->length = (TPCircularBufferLength)round_page(length); // We need whole page sizes.
 
         // Temporarily allocate twice the length,
         // so we have the contiguous address space to support a second instance of the buffer directly after.
         vm_address_t bufferAddress;
         kern_return_t result = vm_allocate(mach_task_self(),
                                            &bufferAddress,
-                                           buffer->length * 2,
+                                           (vm_size_t)buffer->length * 2,
                                            VM_FLAGS_ANYWHERE); // Allocate anywhere it'll fit.
         if ( result != ERR_SUCCESS ) {
             if ( retries-- == 0 ) {
@@ -88,7 +124,7 @@ bool _TPCircularBufferInit(TPCircularBuffer *buffer, int32_t length, size_t stru
             // If this fails somehow, deallocate the whole region and try again.
             vm_deallocate(mach_task_self(),
                           bufferAddress,
-                          buffer->length * 2);
+                          (vm_size_t)buffer->length * 2);
             continue;
         }
         
@@ -134,22 +170,324 @@ bool _TPCircularBufferInit(TPCircularBuffer *buffer, int32_t length, size_t stru
         }
         
         buffer->buffer = (void *)bufferAddress;
-        atomic_store_explicit(&buffer->fillCount, 0, memory_order_release);
-        buffer->head = buffer->tail = 0;
-        buffer->atomic = true;
-        
+        buffer->pageSize = (int32_t)vm_page_size;
         return true;
     }
     return false;
 }
+#else
+static const size_t kHugePageSize = 2 * 1024 * 1024;
+
+#if defined(__linux__)
+#ifndef MFD_HUGE_2MB
+#define MFD_HUGE_2MB (21U << 26) // log2(2 MiB) << MFD_HUGE_SHIFT, from linux/memfd.h
+#endif
+#endif
+
+/*!
+ * Create an anonymous shared memory object, returning its descriptor, or -1 with errno set
+ *
+ *  Linux uses memfd_create, which takes the hugetlb flags. Elsewhere, the flags must be 0,
+ *  and a POSIX shared memory object is created and unlinked straight away.
+ */
+static int _TPCircularBufferCreateMemoryObject(unsigned int memfdFlags) {
+#if defined(__linux__)
+    return memfd_create("TPCircularBuffer", MFD_CLOEXEC | memfdFlags);
+#elif defined(SHM_ANON)
+    (void)memfdFlags;
+    return shm_open(SHM_ANON, O_RDWR | O_CREAT | O_CLOEXEC, 0600);
+#else
+    (void)memfdFlags;
+    static atomic_uint counter;
+    for ( int attempt = 0; attempt < 16; attempt++ ) {
+        char name[64];
+        snprintf(name, sizeof(name), "/TPCircularBuffer-%ld-%u", (long)getpid(),
+                 atomic_fetch_add_explicit(&counter, 1, memory_order_relaxed));
+        int fd = shm_open(name, O_RDWR | O_CREAT | O_EXCL, 0600);
+        if ( fd >= 0 ) {
+            shm_unlink(name);
+            return fd;
+        }
+        if ( errno != EEXIST ) break;
+    }
+    return -1;
+#endif
+}
+
+/*!
+ * Make one attempt at mapping a mirrored buffer of the given length
+ *
+ *  The length must be a multiple of the alignment, which must itself be a multiple of
+ *  the device page size.
+ */
+static bool _TPCircularBufferMapMirror(TPCircularBuffer *buffer,
+                                       size_t bufferLength,
+                                       size_t alignment,
+                                       unsigned int memfdFlags,
+                                       bool reportErrors) {
+    // Create an anonymous shared memory object to back both instances of the buffer.
+    int fd = _TPCircularBufferCreateMemoryObject(memfdFlags);
+    if ( fd < 0 ) {
+        if ( reportErrors ) reportResult(errno, "Buffer allocation");
+        return false;
+    }
+    
+    if ( ftruncate(fd, (off_t)bufferLength) != 0 ) {
+        int error = errno;
+        close(fd);
+        if ( reportErrors ) reportResult(error, "Buffer allocation");
+        return false;
+    }
+    
+    // Reserve twice the length of address space,
+    // so we have the contiguous address space to support a second instance of the buffer directly after.
+    // Reserve extra if we need a greater alignment than mmap guarantees, and trim it afterwards.
+    size_t slack = alignment > (size_t)sysconf(_SC_PAGESIZE) ? alignment : 0;
+    char *reservation = (char *)mmap(NULL,
+                                     bufferLength * 2 + slack,
+                                     PROT_NONE,
+                                     MAP_PRIVATE | MAP_ANONYMOUS,
+                                     -1,
+                                     0);
+    if ( reservation == MAP_FAILED ) {
+        int error = errno;
+        close(fd);
+        if ( reportErrors ) reportResult(error, "Buffer reservation");
+        return false;
+    }
+    
+    char *bufferAddress = (char *)(((uintptr_t)reservation + alignment - 1) & ~(uintptr_t)(alignment - 1));
+    if ( slack ) {
+        if ( bufferAddress > reservation ) {
+            munmap(reservation, (size_t)(bufferAddress - reservation));
+        }
+        char *reservationEnd = reservation + bufferLength * 2 + slack;
+        if ( reservationEnd > bufferAddress + bufferLength * 2 ) {
+            munmap(bufferAddress + bufferLength * 2, (size_t)(reservationEnd - (bufferAddress + bufferLength * 2)));
+        }
+    }
+    
+    // Map the memory object over the first half of the reservation...
+    void *address = mmap(bufferAddress,
+                         bufferLength,
+                         PROT_READ | PROT_WRITE,
+                         MAP_SHARED | MAP_FIXED,
+                         fd,
+                         0);
+    if ( address != bufferAddress ) {
+        int error = errno;
+        munmap(bufferAddress, bufferLength * 2);
+        close(fd);
+        if ( reportErrors ) reportResult(error, "Map buffer memory");
+        return false;
+    }
+    
+    // ...then map it again over the second half, immediately after the buffer.
+    void *virtualAddress = mmap(bufferAddress + bufferLength,
+                                bufferLength,
+                                PROT_READ | PROT_WRITE,
+                                MAP_SHARED | MAP_FIXED,
+                                fd,
+                                0);
+    int error = errno;
+    
+    // The mappings keep the memory object alive, so we no longer need the descriptor.
+    close(fd);
+    
+    if ( virtualAddress != bufferAddress + bufferLength ) {
+        munmap(bufferAddress, bufferLength * 2);
+        if ( reportErrors ) reportResult(error, "Remap buffer memory");
+        return false;
+    }
+    
+    buffer->buffer = bufferAddress;
+    buffer->length = (TPCircularBufferLength)bufferLength;
+    return true;
+}
+
+static bool _TPCircularBufferMapMemory(TPCircularBuffer *buffer, TPCircularBufferLength length, TPCircularBufferOptions options) {
+    size_t pageSize = (size_t)sysconf(_SC_PAGESIZE);
+    size_t alignment = pageSize;
+    
+    if ( options & kTPCircularBufferOptionHugePages ) {
+        size_t bufferLength = ((size_t)length + kHugePageSize - 1) & ~(kHugePageSize - 1);
+        if ( bufferLength > (size_t)kTPCircularBufferMaxLength ) {
+            fprintf(stderr, "TPCircularBuffer: Length too large to round up to huge pages.\n");
+            return false;
+        }
+        
+#if defined(__linux__)
+        // Explicit huge pages are only available if the administrator has reserved some, so
+        // failure here is expected, and not worth reporting.
+        if ( _TPCircularBufferMapMirror(buffer, bufferLength, kHugePageSize, MFD_HUGETLB | MFD_HUGE_2MB, false) ) {
+            buffer->pageSize = (int32_t)kHugePageSize;
+            return true;
+        }
+#endif
+        
+        // Otherwise fall back to normal pages, but keep the huge page rounding and alignment
+        // so the kernel may still back the buffer with transparent huge pages.
+        length = (TPCircularBufferLength)bufferLength;
+        alignment = kHugePageSize;
+    }
+    
+    size_t bufferLength = ((size_t)length + alignment - 1) & ~(alignment - 1); // We need whole page sizes.
+    if ( bufferLength > (size_t)kTPCircularBufferMaxLength ) {
+        fprintf(stderr, "TPCircularBuffer: Length too large to round up to whole pages.\n");
+        return false;
+    }
+    
+    // Keep trying until we get our buffer, needed to handle race conditions.
+    int retries = 3;
+    while ( !_TPCircularBufferMapMirror(buffer, bufferLength, alignment, 0, retries == 0) ) {
+        if ( retries-- == 0 ) {
+            return false;
+        }
+    }
+    
+#if defined(__linux__)
+    if ( alignment > pageSize ) {
+        // Only a hint: whether it's honoured depends on the system's shmem_enabled setting
+        madvise(buffer->buffer, bufferLength * 2, MADV_HUGEPAGE);
+    }
+#endif
+    
+    buffer->pageSize = (int32_t)pageSize;
+    return true;
+}
+
+#if defined(__linux__)
+static bool _TPCircularBufferBindMemory(TPCircularBuffer *buffer, unsigned int node) {
+    // Call mbind directly, rather than requiring libnuma
+    const size_t bitsPerWord = sizeof(unsigned long) * 8;
+    unsigned long nodeMask[(node / bitsPerWord) + 1];
+    memset(nodeMask, 0, sizeof(nodeMask));
+    nodeMask[node / bitsPerWord] = 1UL << (node % bitsPerWord);
+    
+    // Bind both halves: memfd mappings share the policy, but hugetlb mappings each have their own
+    if ( syscall(SYS_mbind, buffer->buffer, (size_t)buffer->length * 2, MPOL_BIND,
+                 nodeMask, sizeof(nodeMask) * 8 + 1, 0) != 0 ) {
+        reportResult(errno, "Bind buffer memory");
+        return false;
+    }
+    return true;
+}
+#endif
+#endif
+
+bool _TPCircularBufferInit(TPCircularBuffer *buffer, TPCircularBufferLength length, size_t structSize) {
+    return _TPCircularBufferInitWithOptions(buffer, length, 0, structSize);
+}
+
+bool _TPCircularBufferInitWithOptions(TPCircularBuffer *buffer, TPCircularBufferLength length, TPCircularBufferOptions options, size_t structSize) {
+    assert(length > 0);
+    
+    if ( structSize != sizeof(TPCircularBuffer) ) {
+        fprintf(stderr,
+                "TPCircularBuffer: Header version mismatch. "
+                "Check for old versions of TPCircularBuffer in your project, "
+                "and that TPCIRCULARBUFFER_SEPARATE_CACHE_LINES, TPCIRCULARBUFFER_CACHED_INDICES, "
+                "TPCIRCULARBUFFER_STATS and TPCIRCULARBUFFER_64BIT_LENGTHS are defined consistently.\n");
+        abort();
+    }
+    
+    if ( !_TPCircularBufferMapMemory(buffer, length, options) ) {
+        return false;
+    }
+    
+    if ( !_TPCircularBufferApplyOptions(buffer, options) ) {
+        TPCircularBufferCleanup(buffer);
+        return false;
+    }
+    
+    _TPCircularBufferInitState(buffer);
+    
+    return true;
+}
+
+bool _TPCircularBufferApplyOptions(TPCircularBuffer *buffer, TPCircularBufferOptions options) {
+    buffer->appliedOptions = 0;
+    
+#if defined(__linux__)
+    // Set the memory policy before anything touches the buffer and allocates its pages
+    if ( options & _kTPCircularBufferOptionNUMANode ) {
+        if ( !_TPCircularBufferBindMemory(buffer, options >> _kTPCircularBufferOptionNUMANodeShift) ) {
+            return false;
+        }
+        buffer->appliedOptions |= _kTPCircularBufferOptionNUMANode;
+    }
+#endif
+    
+    if ( options & kTPCircularBufferOptionLockMemory ) {
+        if ( mlock(buffer->buffer, (size_t)buffer->length * 2) != 0 ) {
+            fprintf(stderr, "TPCircularBuffer: Couldn't lock buffer memory: %s.\n", strerror(errno));
+            return false;
+        }
+        buffer->appliedOptions |= kTPCircularBufferOptionLockMemory;
+    } else if ( options & kTPCircularBufferOptionPrefault ) {
+        // Touch a byte of each page through both mappings, so each page is allocated and both
+        // mappings of it are in the page tables. The memory is already zeroed, so write zeros.
+        volatile char *bytes = (volatile char *)buffer->buffer;
+        for ( int64_t offset = 0; offset < (int64_t)buffer->length * 2; offset += buffer->pageSize ) {
+            bytes[offset] = 0;
+        }
+    }
+    
+    return true;
+}
+
+void _TPCircularBufferResetOptions(TPCircularBuffer *buffer) {
+    if ( buffer->appliedOptions & kTPCircularBufferOptionLockMemory ) {
+        munlock(buffer->buffer, (size_t)buffer->length * 2);
+    }
+#if defined(__linux__)
+    if ( buffer->appliedOptions & _kTPCircularBufferOptionNUMANode ) {
+        syscall(SYS_mbind, buffer->buffer, (size_t)buffer->length * 2, MPOL_DEFAULT, NULL, 0, 0);
+    }
+#endif
+    buffer->appliedOptions = 0;
+}
+
+void _TPCircularBufferInitState(TPCircularBuffer *buffer) {
+#if TPCIRCULARBUFFER_CACHED_INDICES
+    atomic_store_explicit(&buffer->headPosition, 0, memory_order_release);
+    atomic_store_explicit(&buffer->tailPosition, 0, memory_order_release);
+    buffer->cachedHeadPosition = buffer->cachedTailPosition = buffer->lastTailPosition = 0;
+#else
+    atomic_store_explicit(&buffer->fillCount, 0, memory_order_release);
+#endif
+    buffer->head = buffer->tail = 0;
+    buffer->atomic = true;
+    atomic_store_explicit(&buffer->bytesWaiters, 0, memory_order_relaxed);
+    atomic_store_explicit(&buffer->spaceWaiters, 0, memory_order_relaxed);
+#if TPCIRCULARBUFFER_STATS
+    atomic_store_explicit(&buffer->consumerStatsSequence, 0, memory_order_relaxed);
+    atomic_store_explicit(&buffer->bytesConsumed, 0, memory_order_relaxed);
+    atomic_store_explicit(&buffer->emptyEvents, 0, memory_order_relaxed);
+    atomic_store_explicit(&buffer->bytesLost, 0, memory_order_relaxed);
+    atomic_store_explicit(&buffer->producerStatsSequence, 0, memory_order_relaxed);
+    atomic_store_explicit(&buffer->bytesProduced, 0, memory_order_relaxed);
+    atomic_store_explicit(&buffer->fullEvents, 0, memory_order_relaxed);
+    atomic_store_explicit(&buffer->highWaterMark, 0, memory_order_relaxed);
+    atomic_store_explicit(&buffer->largestProduce, 0, memory_order_relaxed);
+#endif
+}
 
 void TPCircularBufferCleanup(TPCircularBuffer *buffer) {
-    vm_deallocate(mach_task_self(), (vm_address_t)buffer->buffer, buffer->length * 2);
+#if defined(__APPLE__)
+    vm_deallocate(mach_task_self(), (vm_address_t)buffer->buffer, (vm_size_t)buffer->length * 2);
+#else
+    munmap(buffer->buffer, (size_t)buffer->length * 2);
+#endif
     memset(buffer, 0, sizeof(TPCircularBuffer));
 }
 
 void TPCircularBufferClear(TPCircularBuffer *buffer) {
-    int32_t fillCount;
+    TPCircularBufferLength fillCount;
+#if TPCIRCULARBUFFER_CACHED_INDICES
+    // Don't rely on the consumer's cached view, which may not include everything produced
+    buffer->cachedHeadPosition = atomic_load_explicit(&buffer->headPosition, memory_order_acquire);
+#endif
     if ( TPCircularBufferTail(buffer, &fillCount) ) {
         TPCircularBufferConsume(buffer, fillCount);
     }
@@ -158,3 +496,116 @@ void TPCircularBufferClear(TPCircularBuffer *buffer) {
 void TPCircularBufferSetAtomic(TPCircularBuffer *buffer, bool atomic) {
     buffer->atomic = atomic;
 }
+
+#pragma mark - Streaming copies
+
+#define kStreamingAlignment       64  // Align streaming stores to whole cache lines
+#define kPrefetchDistance         512 // How far ahead of the copy to prefetch
+
+#if defined(__x86_64__)
+
+__attribute__((target("avx"))) static void _TPCircularBufferStreamingCopyAVX(char *dst, const char *src, size_t length) {
+    for ( ; length >= 128; length -= 128, dst += 128, src += 128 ) {
+        __m256i a = _mm256_loadu_si256((const __m256i *)src);
+        __m256i b = _mm256_loadu_si256((const __m256i *)(src + 32));
+        __m256i c = _mm256_loadu_si256((const __m256i *)(src + 64));
+        __m256i d = _mm256_loadu_si256((const __m256i *)(src + 96));
+        _mm256_stream_si256((__m256i *)dst, a);
+        _mm256_stream_si256((__m256i *)(dst + 32), b);
+        _mm256_stream_si256((__m256i *)(dst + 64), c);
+        _mm256_stream_si256((__m256i *)(dst + 96), d);
+    }
+    memcpy(dst, src, length);
+}
+
+static void _TPCircularBufferStreamingCopySSE2(char *dst, const char *src, size_t length) {
+    for ( ; length >= 64; length -= 64, dst += 64, src += 64 ) {
+        __m128i a = _mm_loadu_si128((const __m128i *)src);
+        __m128i b = _mm_loadu_si128((const __m128i *)(src + 16));
+        __m128i c = _mm_loadu_si128((const __m128i *)(src + 32));
+        __m128i d = _mm_loadu_si128((const __m128i *)(src + 48));
+        _mm_stream_si128((__m128i *)dst, a);
+        _mm_stream_si128((__m128i *)(dst + 16), b);
+        _mm_stream_si128((__m128i *)(dst + 32), c);
+        _mm_stream_si128((__m128i *)(dst + 48), d);
+    }
+    memcpy(dst, src, length);
+}
+
+#elif defined(__aarch64__)
+
+static void _TPCircularBufferStreamingCopyNEON(char *dst, const char *src, size_t length) {
+    for ( ; length >= 64; length -= 64, dst += 64, src += 64 ) {
+        __asm__ __volatile__("ldp  q0, q1, [%1]\n\t"
+                             "ldp  q2, q3, [%1, #32]\n\t"
+                             "stnp q0, q1, [%0]\n\t"
+                             "stnp q2, q3, [%0, #32]"
+                             : : "r"(dst), "r"(src) : "v0", "v1", "v2", "v3", "memory");
+    }
+    memcpy(dst, src, length);
+}
+
+#endif
+
+void _TPCircularBufferStreamingCopy(void *dst, const void *src, size_t length) {
+    // Copy up to a cache line boundary normally, so the streaming stores fill whole lines
+    size_t head = (kStreamingAlignment - ((uintptr_t)dst & (kStreamingAlignment - 1))) & (kStreamingAlignment - 1);
+    if ( head > length ) head = length;
+    memcpy(dst, src, head);
+    char *d = (char *)dst + head;
+    const char *s = (const char *)src + head;
+    length -= head;
+    
+#if defined(__x86_64__)
+    if ( __builtin_cpu_supports("avx") ) {
+        _TPCircularBufferStreamingCopyAVX(d, s, length);
+    } else {
+        _TPCircularBufferStreamingCopySSE2(d, s, length);
+    }
+    // Streaming stores aren't ordered with other stores, so fence before the produce publishes them
+    _mm_sfence();
+#elif defined(__aarch64__)
+    _TPCircularBufferStreamingCopyNEON(d, s, length);
+#else
+    memcpy(d, s, length);
+#endif
+}
+
+void _TPCircularBufferPrefetchingCopy(void *dst, const void *src, size_t length) {
+    char *d = (char *)dst;
+    const char *s = (const char *)src;
+    for ( ; length >= 64; length -= 64, d += 64, s += 64 ) {
+        // Prefetching past the end of the source is harmless: prefetches don't fault
+        __builtin_prefetch(s + kPrefetchDistance, 0, 0);
+        memcpy(d, s, 64);
+    }
+    memcpy(d, s, length);
+}
+
+#if TPCIRCULARBUFFER_STATS
+
+void TPCircularBufferGetStats(const TPCircularBuffer *buffer, TPCircularBufferStats *stats) {
+    // Re-read each side until its sequence count is even and unchanged, so no update overlapped the read
+    while ( true ) {
+        uint32_t sequence = atomic_load_explicit(&buffer->producerStatsSequence, memory_order_acquire);
+        if ( sequence & 1 ) continue;
+        stats->bytesProduced = atomic_load_explicit(&buffer->bytesProduced, memory_order_relaxed);
+        stats->fullEvents = atomic_load_explicit(&buffer->fullEvents, memory_order_relaxed);
+        stats->highWaterMark = atomic_load_explicit(&buffer->highWaterMark, memory_order_relaxed);
+        stats->largestProduce = atomic_load_explicit(&buffer->largestProduce, memory_order_relaxed);
+        atomic_thread_fence(memory_order_acquire);
+        if ( atomic_load_explicit(&buffer->producerStatsSequence, memory_order_relaxed) == sequence ) break;
+    }
+    
+    while ( true ) {
+        uint32_t sequence = atomic_load_explicit(&buffer->consumerStatsSequence, memory_order_acquire);
+        if ( sequence & 1 ) continue;
+        stats->bytesConsumed = atomic_load_explicit(&buffer->bytesConsumed, memory_order_relaxed);
+        stats->emptyEvents = atomic_load_explicit(&buffer->emptyEvents, memory_order_relaxed);
+        stats->bytesLost = atomic_load_explicit(&buffer->bytesLost, memory_order_relaxed);
+        atomic_thread_fence(memory_order_acquire);
+        if ( atomic_load_explicit(&buffer->consumerStatsSequence, memory_order_relaxed) == sequence ) break;
+    }
+}
+
+#endif
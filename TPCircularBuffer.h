@@ -12,6 +12,10 @@
 //  
 //  The implementation is thread-safe in the case of a single producer and single consumer.
 //
+//  On Darwin the mirror is created with vm_remap; on Linux the same anonymous memfd is mapped
+//  twice, back-to-back, within a single address space reservation. Other POSIX systems do the
+//  same with an unlinked shm_open object.
+//
 //  Virtual memory technique originally proposed by Philip Howard (http://vrb.slashusr.org/), and
 //  adapted to Darwin by Kurt Revis (http://www.snoize.com,
 //  http://www.snoize.com/Code/PlayBufferedSoundFile.tar.gz).
@@ -41,6 +45,7 @@
 #define TPCircularBuffer_h
 
 #include <stdbool.h>
+#include <stdint.h>
 #include <string.h>
 #include <assert.h>
 
@@ -53,17 +58,202 @@
     #include <stdatomic.h>
 #endif
 
+#ifndef __deprecated_msg
+    #define __deprecated_msg(_msg) __attribute__((deprecated(_msg)))
+#endif
+
 #ifdef __cplusplus
 extern "C" {
 #endif
     
+/*!
+ * Cache line separation
+ *
+ *  Define TPCIRCULARBUFFER_SEPARATE_CACHE_LINES to 1 to place the consumer-owned tail,
+ *  the producer-owned head and the shared fill count on separate cache lines, so that
+ *  producing doesn't invalidate the line the consumer reads from and vice versa. This
+ *  makes the structure a few hundred bytes larger.
+ *
+ *  The setting must be the same for TPCircularBuffer.c and all code including this
+ *  header; mismatches are caught by TPCircularBufferInit.
+ */
+#ifndef TPCIRCULARBUFFER_SEPARATE_CACHE_LINES
+    #define TPCIRCULARBUFFER_SEPARATE_CACHE_LINES 0
+#endif
+
+#ifndef TPCIRCULARBUFFER_CACHE_LINE_SIZE
+    #if defined(__APPLE__) && defined(__aarch64__)
+        #define TPCIRCULARBUFFER_CACHE_LINE_SIZE 128
+    #else
+        #define TPCIRCULARBUFFER_CACHE_LINE_SIZE 64
+    #endif
+#endif
+
+/*!
+ * Cached indices
+ *
+ *  Define TPCIRCULARBUFFER_CACHED_INDICES to 1 to replace the shared fill count with
+ *  a pair of positions: the producer publishes how many bytes it has produced, and
+ *  the consumer how many it has consumed, each with a plain release store instead of
+ *  an atomic read-modify-write. Each side also caches the other side's last-seen
+ *  position, and only reads it again when the buffer appears full (for the producer)
+ *  or empty (for the consumer).
+ *
+ *  Consequently, in this mode TPCircularBufferHead and TPCircularBufferTail may report
+ *  fewer available bytes than are actually available, until the cached view is
+ *  exhausted; TPCircularBufferProduceBytes re-reads the consumer's position whenever
+ *  the cached view has insufficient space.
+ *
+ *  Like TPCIRCULARBUFFER_SEPARATE_CACHE_LINES, the setting must be the same for
+ *  TPCircularBuffer.c and all code including this header.
+ */
+#ifndef TPCIRCULARBUFFER_CACHED_INDICES
+    #define TPCIRCULARBUFFER_CACHED_INDICES 0
+#endif
+
+/*!
+ * Statistics
+ *
+ *  Define TPCIRCULARBUFFER_STATS to 1 to have each buffer count the bytes produced and
+ *  consumed, the highest fill level reached, the largest single produce, and how often
+ *  the producer found too little space (full events) or the consumer found nothing to
+ *  read (empty events). In overwrite mode (TPCircularBuffer+Overwrite.h), they also count
+ *  the bytes the producer discarded before they were read, as the consumer finds out
+ *  about them. Read them from any thread with TPCircularBufferGetStats.
+ *
+ *  Each side updates only its own counters, with plain loads and stores rather than
+ *  atomic read-modify-writes, and publishes them under a per-side sequence count so
+ *  the reader gets a consistent snapshot.
+ *
+ *  Like TPCIRCULARBUFFER_SEPARATE_CACHE_LINES, the setting must be the same for
+ *  TPCircularBuffer.c and all code including this header.
+ */
+#ifndef TPCIRCULARBUFFER_STATS
+    #define TPCIRCULARBUFFER_STATS 0
+#endif
+
+/*!
+ * Streaming copies
+ *
+ *  TPCircularBufferProduceBytes copies blocks of at least TPCIRCULARBUFFER_STREAMING_THRESHOLD
+ *  bytes with non-temporal stores, which write to memory without first bringing each line
+ *  into the cache, so a large write doesn't evict the producer's working set to make room
+ *  for data only the consumer will read. TPCircularBufferConsumeBytes copies blocks that
+ *  large while prefetching the source with a non-temporal hint, so they pass through the
+ *  consumer's caches with as little pollution as possible.
+ *
+ *  The instructions are chosen at runtime from those the CPU supports (AVX or SSE2 on
+ *  x86-64, or STNP on ARM64); elsewhere, memcpy is used. Define to 0 to always use memcpy.
+ *
+ *  Streaming costs throughput when the consumer would otherwise have found the bytes in
+ *  a cache it shares with the producer, so tune the threshold with the streaming test in
+ *  Benchmark/TPCircularBufferBenchmark.cpp.
+ */
+#ifndef TPCIRCULARBUFFER_STREAMING_THRESHOLD
+    #define TPCIRCULARBUFFER_STREAMING_THRESHOLD (512 * 1024)
+#endif
+
+/*!
+ * 64-bit lengths
+ *
+ *  Define TPCIRCULARBUFFER_64BIT_LENGTHS to 1 for buffers of 2 GiB or more. Buffer
+ *  lengths, offsets and byte counts throughout the API are of type TPCircularBufferLength,
+ *  which is int64_t in this mode and int32_t otherwise, so code written in terms of
+ *  TPCircularBufferLength builds either way. kTPCircularBufferMaxLength is the largest
+ *  length a buffer can have; without this, that's 2 GiB, or 1 GiB with
+ *  TPCIRCULARBUFFER_CACHED_INDICES.
+ *
+ *  On 32-bit platforms, 64-bit atomics may not be lock-free, so leave this off there.
+ *
+ *  Like TPCIRCULARBUFFER_SEPARATE_CACHE_LINES, the setting must be the same for
+ *  TPCircularBuffer.c and all code including this header.
+ */
+#ifndef TPCIRCULARBUFFER_64BIT_LENGTHS
+    #define TPCIRCULARBUFFER_64BIT_LENGTHS 0
+#endif
+
+/*!
+ * Fixed atomicity
+ *
+ *  TPCircularBufferSetAtomic chooses at runtime whether a buffer uses atomic operations,
+ *  so every produce and consume tests the buffer's setting. Define TPCIRCULARBUFFER_ATOMIC
+ *  to 1 to always use atomic operations, or to 0 to never use them, and that test is
+ *  compiled out; TPCircularBufferSetAtomic then has no effect on code built this way.
+ *
+ *  Unlike the options above, this doesn't change the structure, so it can differ between
+ *  translation units: code running a single-threaded pipeline can be built with 0 while
+ *  the rest of the program uses atomic buffers.
+ */
+#if defined(TPCIRCULARBUFFER_ATOMIC) && TPCIRCULARBUFFER_ATOMIC != 0 && TPCIRCULARBUFFER_ATOMIC != 1
+    #error "TPCIRCULARBUFFER_ATOMIC must be 0 or 1"
+#endif
+
+#if TPCIRCULARBUFFER_64BIT_LENGTHS
+    typedef int64_t               TPCircularBufferLength;
+    typedef uint64_t              _TPCircularBufferPosition;
+    typedef atomic_int_least64_t  _TPCircularBufferAtomicLength;
+    typedef atomic_uint_least64_t _TPCircularBufferAtomicPosition;
+    #define kTPCircularBufferMaxLength (INT64_MAX / 2)
+#else
+    typedef int32_t               TPCircularBufferLength;
+    typedef uint32_t              _TPCircularBufferPosition;
+    typedef atomic_int            _TPCircularBufferAtomicLength;
+    typedef atomic_uint           _TPCircularBufferAtomicPosition;
+    #if TPCIRCULARBUFFER_CACHED_INDICES
+        // A side's cached view of the other may be up to twice the length behind
+        #define kTPCircularBufferMaxLength (INT32_MAX / 2)
+    #else
+        #define kTPCircularBufferMaxLength INT32_MAX
+    #endif
+#endif
+
+#if TPCIRCULARBUFFER_SEPARATE_CACHE_LINES
+    #define _TPCircularBufferCacheLinePadding(name) char name[TPCIRCULARBUFFER_CACHE_LINE_SIZE];
+#else
+    #define _TPCircularBufferCacheLinePadding(name)
+#endif
+
+typedef uint32_t TPCircularBufferOptions;
+
 typedef struct {
-    void              *buffer;
-    int32_t           length;
-    int32_t           tail;
-    int32_t           head;
-    atomic_int        fillCount;
-    bool              atomic;
+    void                           *buffer;
+    TPCircularBufferLength          length;
+    int32_t                         pageSize;
+    TPCircularBufferOptions         appliedOptions; // Lock and NUMA options in effect, to undo on reuse
+    _TPCircularBufferCacheLinePadding(_padding0)
+    TPCircularBufferLength          tail;
+#if TPCIRCULARBUFFER_CACHED_INDICES
+    _TPCircularBufferAtomicPosition tailPosition;
+    _TPCircularBufferPosition       cachedHeadPosition;
+    _TPCircularBufferPosition       lastTailPosition;
+#endif
+#if TPCIRCULARBUFFER_STATS
+    atomic_uint                     consumerStatsSequence;
+    atomic_ullong                   bytesConsumed;
+    atomic_ullong                   emptyEvents;
+    atomic_ullong                   bytesLost;
+#endif
+    _TPCircularBufferCacheLinePadding(_padding1)
+    TPCircularBufferLength          head;
+#if TPCIRCULARBUFFER_CACHED_INDICES
+    _TPCircularBufferAtomicPosition headPosition;
+    _TPCircularBufferPosition       cachedTailPosition;
+#endif
+#if TPCIRCULARBUFFER_STATS
+    atomic_uint                     producerStatsSequence;
+    atomic_ullong                   bytesProduced;
+    atomic_ullong                   fullEvents;
+    _TPCircularBufferAtomicLength   highWaterMark;
+    _TPCircularBufferAtomicLength   largestProduce;
+#endif
+#if !TPCIRCULARBUFFER_CACHED_INDICES
+    _TPCircularBufferCacheLinePadding(_padding2)
+    _TPCircularBufferAtomicLength   fillCount;
+#endif
+    _TPCircularBufferCacheLinePadding(_padding3)
+    bool                            atomic;
+    atomic_int                      bytesWaiters;
+    atomic_int                      spaceWaiters;
 } TPCircularBuffer;
 
 /*!
@@ -85,7 +275,54 @@ typedef struct {
  */
 #define TPCircularBufferInit(buffer, length) \
     _TPCircularBufferInit(buffer, length, sizeof(*buffer))
-bool _TPCircularBufferInit(TPCircularBuffer *buffer, int32_t length, size_t structSize);
+bool _TPCircularBufferInit(TPCircularBuffer *buffer, TPCircularBufferLength length, size_t structSize);
+
+/*!
+ * Initialisation options
+ *
+ *  kTPCircularBufferOptionHugePages: Back the buffer with 2 MiB huge pages, to reduce
+ *  TLB pressure for large buffers. The length is rounded up to a multiple of 2 MiB.
+ *  On Linux, this uses hugetlbfs pages if the system has some reserved (vm.nr_hugepages),
+ *  and otherwise falls back to normal pages, aligned and marked so the kernel may use
+ *  transparent huge pages for them. Other platforms always use normal pages. Use
+ *  TPCircularBufferPageSize to find out which you got.
+ *
+ *  kTPCircularBufferOptionPrefault: Fault in every page of the buffer, and of its
+ *  mirror, during initialisation, so the first pass through the buffer doesn't take
+ *  page faults on the realtime thread.
+ *
+ *  kTPCircularBufferOptionLockMemory: Lock the buffer into memory with mlock, so it's
+ *  never paged out. This also prefaults it. Initialisation fails if the memory can't
+ *  be locked, e.g. because of RLIMIT_MEMLOCK.
+ *
+ *  TPCircularBufferOptionNUMANode(node): Allocate the buffer's memory on the given
+ *  NUMA node only. Combine with kTPCircularBufferOptionPrefault to allocate it during
+ *  initialisation rather than wherever it's first touched. Initialisation fails if the
+ *  node doesn't exist. Linux only; ignored elsewhere.
+ */
+enum {
+    kTPCircularBufferOptionHugePages  = 1 << 0,
+    kTPCircularBufferOptionPrefault   = 1 << 1,
+    kTPCircularBufferOptionLockMemory = 1 << 2,
+    _kTPCircularBufferOptionNUMANode  = 1 << 3,
+};
+
+#define _kTPCircularBufferOptionNUMANodeShift 16
+#define TPCircularBufferOptionNUMANode(node) \
+    (_kTPCircularBufferOptionNUMANode | ((TPCircularBufferOptions)(node) << _kTPCircularBufferOptionNUMANodeShift))
+
+/*!
+ * Initialise buffer, with options
+ *
+ *  As TPCircularBufferInit, with the given combination of kTPCircularBufferOption values.
+ *
+ * @param buffer Circular buffer
+ * @param length Length of buffer
+ * @param options Initialisation options
+ */
+#define TPCircularBufferInitWithOptions(buffer, length, options) \
+    _TPCircularBufferInitWithOptions(buffer, length, options, sizeof(*buffer))
+bool _TPCircularBufferInitWithOptions(TPCircularBuffer *buffer, TPCircularBufferLength length, TPCircularBufferOptions options, size_t structSize);
 
 /*!
  * Cleanup buffer
@@ -114,13 +351,442 @@ void TPCircularBufferClear(TPCircularBuffer *buffer);
  *
  *  The default value is true (the buffer will use atomic operations).
  *
+ *  Code built with TPCIRCULARBUFFER_ATOMIC defined ignores this setting.
+ *
  * @param buffer Circular buffer
  * @param atomic Whether the buffer is atomic (default true)
  */
 void TPCircularBufferSetAtomic(TPCircularBuffer *buffer, bool atomic);
 
+/*!
+ * Get the page size backing the buffer
+ *
+ *  This is the size of the pages the buffer was explicitly allocated with: 2 MiB if
+ *  huge pages were requested and obtained, or the device page size otherwise. Transparent
+ *  huge pages the kernel may use opportunistically aren't reflected here.
+ *
+ * @param buffer Circular buffer
+ * @return Page size in bytes
+ */
+static __inline__ __attribute__((always_inline)) int32_t TPCircularBufferPageSize(const TPCircularBuffer *buffer) {
+    return buffer->pageSize;
+}
+
+#if TPCIRCULARBUFFER_STATS
+
+/*!
+ * A snapshot of a buffer's statistics
+ *
+ *  The producer's counters are consistent with each other, as are the consumer's,
+ *  but the two sides are read one after the other.
+ */
+typedef struct {
+    uint64_t               bytesProduced;
+    uint64_t               bytesConsumed;
+    uint64_t               fullEvents;     // Times the producer found too little space
+    uint64_t               emptyEvents;    // Times the consumer found nothing to read
+    TPCircularBufferLength highWaterMark;  // Highest fill level after a produce
+    TPCircularBufferLength largestProduce; // Largest single produce, in bytes
+    uint64_t               bytesLost;      // Bytes an overwriting producer discarded before they were read
+} TPCircularBufferStats;
+
+/*!
+ * Get the buffer's statistics
+ *
+ *  Safe to call from any thread, while the producer and consumer are running.
+ *  With TPCIRCULARBUFFER_CACHED_INDICES, the high-water mark is based on the
+ *  producer's cached view of the consumer, so it may be an overestimate.
+ *
+ *  Requires TPCIRCULARBUFFER_STATS.
+ *
+ * @param buffer Circular buffer
+ * @param stats On output, the statistics
+ */
+void TPCircularBufferGetStats(const TPCircularBuffer *buffer, TPCircularBufferStats *stats);
+
+#endif
+
+#pragma mark - Internal
+
+/*!
+ * Whether to use atomic operations: as fixed by TPCIRCULARBUFFER_ATOMIC, or else the buffer's setting
+ */
+static __inline__ __attribute__((always_inline)) bool _TPCircularBufferAtomic(const TPCircularBuffer *buffer) {
+#ifdef TPCIRCULARBUFFER_ATOMIC
+    (void)buffer;
+    return TPCIRCULARBUFFER_ATOMIC;
+#else
+    return buffer->atomic;
+#endif
+}
+
+/*!
+ * Reset the indices and counters of a buffer whose memory has already been mapped
+ *
+ *  For variants that map the buffer memory themselves.
+ */
+void _TPCircularBufferInitState(TPCircularBuffer *buffer);
+
+/*!
+ * Apply the NUMA node, locking and prefaulting options to a buffer whose memory has been mapped
+ *
+ * @return true on success, false if the memory couldn't be bound or locked
+ */
+bool _TPCircularBufferApplyOptions(TPCircularBuffer *buffer, TPCircularBufferOptions options);
+
+/*!
+ * Undo the locking and NUMA memory policy applied to the buffer, if any, so its memory can be reused plainly
+ *
+ *  Makes no system calls for a buffer that had neither. Pages already placed on a NUMA node stay there.
+ */
+void _TPCircularBufferResetOptions(TPCircularBuffer *buffer);
+
+/*!
+ * Copy with non-temporal stores, then fence so the stores are visible before the bytes are produced
+ */
+void _TPCircularBufferStreamingCopy(void *dst, const void *src, size_t length);
+
+/*!
+ * Copy while prefetching the source with a non-temporal hint
+ */
+void _TPCircularBufferPrefetchingCopy(void *dst, const void *src, size_t length);
+
+#define kTPCircularBufferSmallCopyLimit 128
+
+/*!
+ * Copy up to kTPCircularBufferSmallCopyLimit bytes inline
+ *
+ *  Copies the first and last bytes with two fixed-size copies that overlap in the middle.
+ *  The compiler turns each into a few vector loads and stores (SSE or AVX on x86, NEON on
+ *  ARM), which avoids a call to memcpy and its dispatch on length.
+ */
+#if defined(__GNUC__) && !defined(__clang__)
+    // GCC can warn about the branches for longer lengths when it inlines a constant length, though they're unreachable
+    #pragma GCC diagnostic push
+    #pragma GCC diagnostic ignored "-Wpragmas"
+    #pragma GCC diagnostic ignored "-Warray-bounds"
+    #pragma GCC diagnostic ignored "-Wstringop-overflow"
+    #pragma GCC diagnostic ignored "-Wstringop-overread"
+#endif
+static __inline__ __attribute__((always_inline)) void _TPCircularBufferCopySmall(void *dst, const void *src, int32_t length) {
+    char *d = (char *)dst;
+    const char *s = (const char *)src;
+    if ( length > 64 ) {
+        memcpy(d, s, 64);
+        memcpy(d + length - 64, s + length - 64, 64);
+    } else if ( length > 32 ) {
+        memcpy(d, s, 32);
+        memcpy(d + length - 32, s + length - 32, 32);
+    } else if ( length > 16 ) {
+        memcpy(d, s, 16);
+        memcpy(d + length - 16, s + length - 16, 16);
+    } else if ( length >= 8 ) {
+        memcpy(d, s, 8);
+        memcpy(d + length - 8, s + length - 8, 8);
+    } else if ( length >= 4 ) {
+        memcpy(d, s, 4);
+        memcpy(d + length - 4, s + length - 4, 4);
+    } else if ( length > 0 ) {
+        d[0] = s[0];
+        d[length / 2] = s[length / 2];
+        d[length - 1] = s[length - 1];
+    }
+}
+#if defined(__GNUC__) && !defined(__clang__)
+    #pragma GCC diagnostic pop
+#endif
+
+/*!
+ * Copy bytes into the buffer: small copies inline, large blocks streamed
+ */
+static __inline__ __attribute__((always_inline)) void _TPCircularBufferCopyIn(void *dst, const void *src, TPCircularBufferLength length) {
+    if ( length <= kTPCircularBufferSmallCopyLimit ) {
+        _TPCircularBufferCopySmall(dst, src, length);
+    } else if ( TPCIRCULARBUFFER_STREAMING_THRESHOLD > 0 && length >= TPCIRCULARBUFFER_STREAMING_THRESHOLD ) {
+        _TPCircularBufferStreamingCopy(dst, src, (size_t)length);
+    } else {
+        memcpy(dst, src, length);
+    }
+}
+
+/*!
+ * Copy bytes out of the buffer: small copies inline, large blocks prefetched
+ */
+static __inline__ __attribute__((always_inline)) void _TPCircularBufferCopyOut(void *dst, const void *src, TPCircularBufferLength length) {
+    if ( length <= kTPCircularBufferSmallCopyLimit ) {
+        _TPCircularBufferCopySmall(dst, src, length);
+    } else if ( TPCIRCULARBUFFER_STREAMING_THRESHOLD > 0 && length >= TPCIRCULARBUFFER_STREAMING_THRESHOLD ) {
+        _TPCircularBufferPrefetchingCopy(dst, src, (size_t)length);
+    } else {
+        memcpy(dst, src, length);
+    }
+}
+
+#if TPCIRCULARBUFFER_CACHED_INDICES
+
+/*!
+ * Number of bytes ready for reading, as seen by the consumer
+ *
+ *  Uses the cached producer position, and only re-reads the shared one if that indicates
+ *  the buffer is empty. Negative if the consumer has consumed past the producer.
+ */
+static __inline__ __attribute__((always_inline)) TPCircularBufferLength _TPCircularBufferConsumerFillCount(const TPCircularBuffer *buffer,
+                                                                                                           bool atomic) {
+    TPCircularBuffer *consumerState = (TPCircularBuffer *)buffer; // The cached position is owned by the consumer
+    _TPCircularBufferPosition tailPosition = atomic_load_explicit(&buffer->tailPosition, memory_order_relaxed);
+    TPCircularBufferLength fillCount = (TPCircularBufferLength)(consumerState->cachedHeadPosition - tailPosition);
+    if ( fillCount <= 0 ) {
+        consumerState->cachedHeadPosition = (atomic ?
+                                             atomic_load_explicit(&buffer->headPosition, memory_order_acquire) :
+                                             atomic_load_explicit(&buffer->headPosition, memory_order_relaxed));
+        fillCount = (TPCircularBufferLength)(consumerState->cachedHeadPosition - tailPosition);
+    }
+    return fillCount;
+}
+
+/*!
+ * Number of bytes ready for reading, as seen by the producer
+ *
+ *  Uses the cached consumer position, and only re-reads the shared one if that indicates
+ *  the buffer is full, or if refresh is true.
+ */
+static __inline__ __attribute__((always_inline)) TPCircularBufferLength _TPCircularBufferProducerFillCount(const TPCircularBuffer *buffer,
+                                                                                                           bool atomic,
+                                                                                                           bool refresh) {
+    TPCircularBuffer *producerState = (TPCircularBuffer *)buffer; // The cached position is owned by the producer
+    _TPCircularBufferPosition headPosition = atomic_load_explicit(&buffer->headPosition, memory_order_relaxed);
+    TPCircularBufferLength fillCount = (TPCircularBufferLength)(headPosition - producerState->cachedTailPosition);
+    if ( refresh || fillCount >= buffer->length ) {
+        producerState->cachedTailPosition = (atomic ?
+                                             atomic_load_explicit(&buffer->tailPosition, memory_order_acquire) :
+                                             atomic_load_explicit(&buffer->tailPosition, memory_order_relaxed));
+        fillCount = (TPCircularBufferLength)(headPosition - producerState->cachedTailPosition);
+    }
+    return fillCount;
+}
+
+#else
+
+static __inline__ __attribute__((always_inline)) TPCircularBufferLength _TPCircularBufferConsumerFillCount(const TPCircularBuffer *buffer,
+                                                                                                           bool atomic) {
+    return (atomic ?
+            atomic_load_explicit(&buffer->fillCount, memory_order_acquire) :
+            atomic_load_explicit(&buffer->fillCount, memory_order_relaxed));
+}
+
+static __inline__ __attribute__((always_inline)) TPCircularBufferLength _TPCircularBufferProducerFillCount(const TPCircularBuffer *buffer,
+                                                                                                           bool atomic,
+                                                                                                           bool refresh) {
+    (void)refresh; // There's no cached view to refresh
+    return (atomic ?
+            atomic_load_explicit(&buffer->fillCount, memory_order_acquire) :
+            atomic_load_explicit(&buffer->fillCount, memory_order_relaxed));
+}
+
+#endif
+
+#if TPCIRCULARBUFFER_STATS
+
+/*!
+ * Open and close an update of one side's statistics
+ *
+ *  The sequence count is odd while an update is in progress, so readers can retry.
+ */
+static __inline__ __attribute__((always_inline)) void _TPCircularBufferStatsBeginUpdate(atomic_uint *sequence) {
+    atomic_store_explicit(sequence, atomic_load_explicit(sequence, memory_order_relaxed) + 1, memory_order_relaxed);
+    atomic_thread_fence(memory_order_release);
+}
+
+static __inline__ __attribute__((always_inline)) void _TPCircularBufferStatsEndUpdate(atomic_uint *sequence) {
+    atomic_store_explicit(sequence, atomic_load_explicit(sequence, memory_order_relaxed) + 1, memory_order_release);
+}
+
+static __inline__ __attribute__((always_inline)) void _TPCircularBufferStatsAdd(atomic_ullong *counter, uint64_t amount) {
+    atomic_store_explicit(counter, atomic_load_explicit(counter, memory_order_relaxed) + amount, memory_order_relaxed);
+}
+
+static __inline__ __attribute__((always_inline)) void _TPCircularBufferStatsMax(_TPCircularBufferAtomicLength *value, TPCircularBufferLength candidate) {
+    if ( candidate > atomic_load_explicit(value, memory_order_relaxed) ) {
+        atomic_store_explicit(value, candidate, memory_order_relaxed);
+    }
+}
+
+static __inline__ __attribute__((always_inline)) void _TPCircularBufferStatsProduced(TPCircularBuffer *buffer,
+                                                                                     TPCircularBufferLength amount,
+                                                                                     TPCircularBufferLength fillCount) {
+    _TPCircularBufferStatsBeginUpdate(&buffer->producerStatsSequence);
+    _TPCircularBufferStatsAdd(&buffer->bytesProduced, (uint64_t)amount);
+    _TPCircularBufferStatsMax(&buffer->highWaterMark, fillCount);
+    _TPCircularBufferStatsMax(&buffer->largestProduce, amount);
+    _TPCircularBufferStatsEndUpdate(&buffer->producerStatsSequence);
+}
+
+static __inline__ __attribute__((always_inline)) void _TPCircularBufferStatsConsumed(TPCircularBuffer *buffer,
+                                                                                     TPCircularBufferLength amount) {
+    _TPCircularBufferStatsBeginUpdate(&buffer->consumerStatsSequence);
+    _TPCircularBufferStatsAdd(&buffer->bytesConsumed, (uint64_t)amount);
+    _TPCircularBufferStatsEndUpdate(&buffer->consumerStatsSequence);
+}
+
+static __inline__ __attribute__((always_inline)) void _TPCircularBufferStatsFull(const TPCircularBuffer *buffer) {
+    TPCircularBuffer *producerState = (TPCircularBuffer *)buffer; // The producer's counters are owned by the producer
+    _TPCircularBufferStatsBeginUpdate(&producerState->producerStatsSequence);
+    _TPCircularBufferStatsAdd(&producerState->fullEvents, 1);
+    _TPCircularBufferStatsEndUpdate(&producerState->producerStatsSequence);
+}
+
+static __inline__ __attribute__((always_inline)) void _TPCircularBufferStatsEmpty(const TPCircularBuffer *buffer) {
+    TPCircularBuffer *consumerState = (TPCircularBuffer *)buffer; // The consumer's counters are owned by the consumer
+    _TPCircularBufferStatsBeginUpdate(&consumerState->consumerStatsSequence);
+    _TPCircularBufferStatsAdd(&consumerState->emptyEvents, 1);
+    _TPCircularBufferStatsEndUpdate(&consumerState->consumerStatsSequence);
+}
+
+static __inline__ __attribute__((always_inline)) void _TPCircularBufferStatsLost(TPCircularBuffer *buffer,
+                                                                                 uint64_t amount) {
+    _TPCircularBufferStatsBeginUpdate(&buffer->consumerStatsSequence);
+    _TPCircularBufferStatsAdd(&buffer->bytesLost, amount);
+    _TPCircularBufferStatsEndUpdate(&buffer->consumerStatsSequence);
+}
+
+#else
+
+static __inline__ __attribute__((always_inline)) void _TPCircularBufferStatsProduced(TPCircularBuffer *buffer,
+                                                                                     TPCircularBufferLength amount,
+                                                                                     TPCircularBufferLength fillCount) {
+    (void)buffer; (void)amount; (void)fillCount;
+}
+
+static __inline__ __attribute__((always_inline)) void _TPCircularBufferStatsConsumed(TPCircularBuffer *buffer,
+                                                                                     TPCircularBufferLength amount) {
+    (void)buffer; (void)amount;
+}
+
+static __inline__ __attribute__((always_inline)) void _TPCircularBufferStatsFull(const TPCircularBuffer *buffer) {
+    (void)buffer;
+}
+
+static __inline__ __attribute__((always_inline)) void _TPCircularBufferStatsEmpty(const TPCircularBuffer *buffer) {
+    (void)buffer;
+}
+
+static __inline__ __attribute__((always_inline)) void _TPCircularBufferStatsLost(TPCircularBuffer *buffer,
+                                                                                 uint64_t amount) {
+    (void)buffer; (void)amount;
+}
+
+#endif
+
+/*!
+ * Advance the tail and publish the consumed bytes to the producer
+ */
+static __inline__ __attribute__((always_inline)) void _TPCircularBufferAdvanceTail(TPCircularBuffer *buffer,
+                                                                                   TPCircularBufferLength amount,
+                                                                                   bool atomic) {
+    // amount never exceeds the buffer length, so a single conditional subtraction wraps the offset.
+    // Compare against the bytes before the end rather than adding first, which could overflow.
+    assert(amount <= buffer->length);
+    TPCircularBufferLength untilEnd = buffer->length - buffer->tail;
+    buffer->tail = amount >= untilEnd ? amount - untilEnd : buffer->tail + amount;
+#if TPCIRCULARBUFFER_CACHED_INDICES
+    _TPCircularBufferPosition tailPosition = atomic_load_explicit(&buffer->tailPosition, memory_order_relaxed) + (_TPCircularBufferPosition)amount;
+    if ( atomic ) {
+        atomic_store_explicit(&buffer->tailPosition, tailPosition, memory_order_release);
+    } else {
+        atomic_store_explicit(&buffer->tailPosition, tailPosition, memory_order_relaxed);
+    }
+#else
+    if ( atomic ) {
+        atomic_fetch_sub_explicit(&buffer->fillCount, amount, memory_order_acq_rel);
+    } else {
+        atomic_store_explicit(&buffer->fillCount,
+                              atomic_load_explicit(&buffer->fillCount, memory_order_relaxed) - amount,
+                              memory_order_relaxed);
+    }
+#endif
+    _TPCircularBufferStatsConsumed(buffer, amount);
+}
+
+/*!
+ * Advance the head and publish the produced bytes to the consumer
+ *
+ * @return Number of bytes ready for reading before the operation
+ */
+static __inline__ __attribute__((always_inline)) TPCircularBufferLength _TPCircularBufferAdvanceHead(TPCircularBuffer *buffer,
+                                                                                                     TPCircularBufferLength amount,
+                                                                                                     bool atomic) {
+    TPCircularBufferLength untilEnd = buffer->length - buffer->head;
+    buffer->head = amount >= untilEnd ? amount - untilEnd : buffer->head + amount;
+    TPCircularBufferLength previousFillCount;
+#if TPCIRCULARBUFFER_CACHED_INDICES
+    _TPCircularBufferPosition headPosition = atomic_load_explicit(&buffer->headPosition, memory_order_relaxed);
+    previousFillCount = (TPCircularBufferLength)(headPosition - buffer->cachedTailPosition);
+    if ( previousFillCount + amount > buffer->length ) {
+        previousFillCount = _TPCircularBufferProducerFillCount(buffer, atomic, true);
+    }
+    if ( atomic ) {
+        atomic_store_explicit(&buffer->headPosition, headPosition + (_TPCircularBufferPosition)amount, memory_order_release);
+    } else {
+        atomic_store_explicit(&buffer->headPosition, headPosition + (_TPCircularBufferPosition)amount, memory_order_relaxed);
+    }
+#else
+    if ( atomic ) {
+        previousFillCount = atomic_fetch_add_explicit(&buffer->fillCount, amount, memory_order_acq_rel);
+    } else {
+        previousFillCount = atomic_load_explicit(&buffer->fillCount, memory_order_relaxed);
+        atomic_store_explicit(&buffer->fillCount, previousFillCount + amount, memory_order_relaxed);
+    }
+#endif
+    assert(previousFillCount + amount <= buffer->length);
+    _TPCircularBufferStatsProduced(buffer, amount, previousFillCount + amount);
+    return previousFillCount;
+}
+
 #pragma mark - Reading (consuming)
 
+/*!
+ * Access end of buffer, with the given atomicity
+ *
+ *  The consuming functions below take their atomicity from _TPCircularBufferAtomic; these
+ *  take it as an argument, for wrappers that fix it at compile time by other means.
+ */
+static __inline__ __attribute__((always_inline)) void *_TPCircularBufferTail(const TPCircularBuffer *buffer,
+                                                                             TPCircularBufferLength *availableBytes,
+                                                                             bool atomic) {
+    TPCircularBufferLength fillCount = _TPCircularBufferConsumerFillCount(buffer, atomic);
+    *availableBytes = (fillCount <= 0 ? 0 : fillCount);
+
+    if ( *availableBytes == 0 ) {
+        _TPCircularBufferStatsEmpty(buffer);
+        return NULL;
+    }
+    return (void *)((char *)buffer->buffer + buffer->tail);
+}
+
+/*!
+ * Copy bytes from buffer, with the given atomicity
+ */
+static __inline__ __attribute__((always_inline)) bool _TPCircularBufferConsumeBytes(TPCircularBuffer *buffer,
+                                                                                    void *dst,
+                                                                                    TPCircularBufferLength len,
+                                                                                    bool atomic) {
+    TPCircularBufferLength available;
+    void *ptr = _TPCircularBufferTail(buffer, &available, atomic);
+#if TPCIRCULARBUFFER_CACHED_INDICES
+    if ( available < len && available > 0 ) {
+        // The cached view of the producer may be stale; look again before giving up
+        buffer->cachedHeadPosition = (atomic ?
+                                      atomic_load_explicit(&buffer->headPosition, memory_order_acquire) :
+                                      atomic_load_explicit(&buffer->headPosition, memory_order_relaxed));
+        ptr = _TPCircularBufferTail(buffer, &available, atomic);
+    }
+#endif
+    if ( available < len ) return false;
+    _TPCircularBufferCopyOut(dst, ptr, len);
+    _TPCircularBufferAdvanceTail(buffer, len, atomic);
+    return true;
+}
+
 /*!
  * Access end of buffer
  *
@@ -132,14 +798,8 @@ void TPCircularBufferSetAtomic(TPCircularBuffer *buffer, bool atomic);
  * @return Pointer to the first bytes ready for reading, or NULL if buffer is empty
  */
 static __inline__ __attribute__((always_inline)) void *TPCircularBufferTail(const TPCircularBuffer *buffer,
-                                                                            int32_t *availableBytes) {
-    int fillCount = (buffer->atomic ?
-                     atomic_load_explicit(&buffer->fillCount, memory_order_acquire) :
-                     buffer->fillCount);
-    *availableBytes = (fillCount <= 0 ? 0 : fillCount);
-
-    if ( *availableBytes == 0 ) return NULL;
-    return (void *)((char *)buffer->buffer + buffer->tail);
+                                                                            TPCircularBufferLength *availableBytes) {
+    return _TPCircularBufferTail(buffer, availableBytes, _TPCircularBufferAtomic(buffer));
 }
 
 /*!
@@ -151,34 +811,40 @@ static __inline__ __attribute__((always_inline)) void *TPCircularBufferTail(cons
  * @param amount Number of bytes to consume
  */
 static __inline__ __attribute__((always_inline)) void TPCircularBufferConsume(TPCircularBuffer *buffer,
-                                                                              int32_t amount) {
-    buffer->tail = (buffer->tail + amount) % buffer->length;
-    if ( buffer->atomic ) {
-        atomic_fetch_sub_explicit(&buffer->fillCount, amount, memory_order_acq_rel);
-    } else {
-        buffer->fillCount -= amount;
-    }
+                                                                              TPCircularBufferLength amount) {
+    _TPCircularBufferAdvanceTail(buffer, amount, _TPCircularBufferAtomic(buffer));
 }
 
-#pragma mark - Writing (producing)
-
 /*!
- * Access front of buffer
+ * Helper routine to copy bytes from buffer
  *
- *  This gives you a pointer to the front of the buffer, ready
- *  for writing, and the number of available bytes to write.
+ *  This copies the given number of bytes out of the buffer, and frees them up
+ *  for writing again.
  *
  * @param buffer Circular buffer
- * @param availableBytes On output, the number of bytes ready for writing
- * @param discardBytes On output, the number of bytes to discard before writing
- * @return Pointer to the first bytes ready for writing, or NULL if buffer is full
+ * @param dst Destination buffer
+ * @param len Number of bytes to copy
+ * @return true if bytes copied, false if fewer than len bytes were available
  */
-static __inline__ __attribute__((always_inline)) void *TPCircularBufferHead(const TPCircularBuffer *buffer,
-                                                                            int32_t *availableBytes,
-                                                                            int32_t *discardBytes) {
-    int fillCount = (buffer->atomic ?
-                     atomic_load_explicit(&buffer->fillCount, memory_order_acquire) :
-                     buffer->fillCount);
+static __inline__ __attribute__((always_inline)) bool TPCircularBufferConsumeBytes(TPCircularBuffer *buffer,
+                                                                                   void *dst,
+                                                                                   TPCircularBufferLength len) {
+    return _TPCircularBufferConsumeBytes(buffer, dst, len, _TPCircularBufferAtomic(buffer));
+}
+
+#pragma mark - Writing (producing)
+
+/*!
+ * Access front of buffer, with the given atomicity and without counting a full event
+ *
+ *  For helpers that look more than once before deciding there's too little space, and
+ *  wrappers that fix the atomicity at compile time.
+ */
+static __inline__ __attribute__((always_inline)) void *_TPCircularBufferHead(const TPCircularBuffer *buffer,
+                                                                             TPCircularBufferLength *availableBytes,
+                                                                             TPCircularBufferLength *discardBytes,
+                                                                             bool atomic) {
+    TPCircularBufferLength fillCount = _TPCircularBufferProducerFillCount(buffer, atomic, false);
     if (fillCount <= 0) {
         *availableBytes = buffer->length;
         *discardBytes = -fillCount;
@@ -191,28 +857,83 @@ static __inline__ __attribute__((always_inline)) void *TPCircularBufferHead(cons
     return (void *)((char *)buffer->buffer + buffer->head);
 }
 
+/*!
+ * Access front of buffer
+ *
+ *  This gives you a pointer to the front of the buffer, ready
+ *  for writing, and the number of available bytes to write.
+ *
+ * @param buffer Circular buffer
+ * @param availableBytes On output, the number of bytes ready for writing
+ * @param discardBytes On output, the number of bytes to discard before writing
+ * @return Pointer to the first bytes ready for writing, or NULL if buffer is full
+ */
+static __inline__ __attribute__((always_inline)) void *TPCircularBufferHead(const TPCircularBuffer *buffer,
+                                                                            TPCircularBufferLength *availableBytes,
+                                                                            TPCircularBufferLength *discardBytes) {
+    void *ptr = _TPCircularBufferHead(buffer, availableBytes, discardBytes, _TPCircularBufferAtomic(buffer));
+    if ( !ptr ) _TPCircularBufferStatsFull(buffer);
+    return ptr;
+}
+
 /*!
  * Produce bytes in buffer
  *
  *  This marks the given section of the buffer ready for reading.
  *
+ *  With TPCIRCULARBUFFER_CACHED_INDICES, the returned count is based on the
+ *  producer's cached view of the consumer, so it may be an overestimate.
+ *
  * @param buffer Circular buffer
  * @param amount Number of bytes to produce
  * @return Number of bytes ready for reading before the operation
  */
-static __inline__ __attribute__((always_inline)) int TPCircularBufferProduce(TPCircularBuffer *buffer,
-                                                                              int32_t amount) {
-    buffer->head = (buffer->head + amount) % buffer->length;
-    int previousFillCount;
-    if ( buffer->atomic ) {
-        previousFillCount = atomic_fetch_add_explicit(&buffer->fillCount, amount, memory_order_acq_rel);
+static __inline__ __attribute__((always_inline)) TPCircularBufferLength TPCircularBufferProduce(TPCircularBuffer *buffer,
+                                                                                                TPCircularBufferLength amount) {
+    return _TPCircularBufferAdvanceHead(buffer, amount, _TPCircularBufferAtomic(buffer));
+}
+
+/*!
+ * Copy bytes to the front of the buffer without producing them, with the given atomicity
+ *
+ * @return true if bytes copied, false if there was insufficient space
+ */
+static __inline__ __attribute__((always_inline)) bool _TPCircularBufferCopyToHead(TPCircularBuffer *buffer,
+                                                                                  const void *src,
+                                                                                  TPCircularBufferLength len,
+                                                                                  bool atomic) {
+    TPCircularBufferLength space, discard;
+    void *ptr = _TPCircularBufferHead(buffer, &space, &discard, atomic);
+#if TPCIRCULARBUFFER_CACHED_INDICES
+    if ( space < len - discard ) {
+        // The cached view of the consumer may be stale; look again before giving up
+        _TPCircularBufferProducerFillCount(buffer, atomic, true);
+        ptr = _TPCircularBufferHead(buffer, &space, &discard, atomic);
+    }
+#endif
+    if ( space < len - discard ) {
+        _TPCircularBufferStatsFull(buffer);
+        return false;
+    }
+    if ( __builtin_expect(discard == 0, 1) ) {
+        // Keep the length as the caller gave it, so a constant length selects its copy at compile time
+        _TPCircularBufferCopyIn(ptr, src, len);
     } else {
-        previousFillCount = buffer->fillCount;
-        buffer->fillCount += amount;
+        memcpy((char *)ptr + discard, (const char *)src + discard, len - discard);
     }
-    assert(previousFillCount + amount <= buffer->length);
-    
-    return previousFillCount;
+    return true;
+}
+
+/*!
+ * Copy bytes to buffer, with the given atomicity
+ */
+static __inline__ __attribute__((always_inline)) bool _TPCircularBufferProduceBytes(TPCircularBuffer *buffer,
+                                                                                    const void *src,
+                                                                                    TPCircularBufferLength len,
+                                                                                    bool atomic) {
+    if ( !_TPCircularBufferCopyToHead(buffer, src, len, atomic) ) return false;
+    _TPCircularBufferAdvanceHead(buffer, len, atomic);
+    return true;
 }
 
 /*!
@@ -227,15 +948,171 @@ static __inline__ __attribute__((always_inline)) int TPCircularBufferProduce(TPC
  */
 static __inline__ __attribute__((always_inline)) bool TPCircularBufferProduceBytes(TPCircularBuffer *buffer,
                                                                                    const void *src,
-                                                                                   int32_t len) {
-    int32_t space, discard;
-    void *ptr = TPCircularBufferHead(buffer, &space, &discard);
-    if ( space < len - discard ) return false;
-    memcpy(ptr + discard, src + discard, len - discard);
-    TPCircularBufferProduce(buffer, len);
+                                                                                   TPCircularBufferLength len) {
+    return _TPCircularBufferProduceBytes(buffer, src, len, _TPCircularBufferAtomic(buffer));
+}
+
+#pragma mark - Batching
+
+/*!
+ * A batch of writes or reads against a single snapshot of the buffer
+ *
+ *  Batches let you write or read many small records while querying the
+ *  buffer and publishing the result only once, rather than once per record.
+ */
+typedef struct {
+    char                  *bytes;
+    TPCircularBufferLength available;
+    TPCircularBufferLength length;
+    TPCircularBufferLength discard;
+} TPCircularBufferBatch;
+
+/*!
+ * Begin a batch of writes
+ *
+ *  Takes a snapshot of the space available at the front of the buffer. Use
+ *  TPCircularBufferBatchAppendBytes or TPCircularBufferBatchReserve to add to the
+ *  batch, then TPCircularBufferCommitWriteBatch to publish everything at once.
+ *
+ * @param buffer Circular buffer
+ * @param batch The batch to initialise
+ * @return true if there is space to write, false if the buffer is full
+ */
+static __inline__ __attribute__((always_inline)) bool TPCircularBufferBeginWriteBatch(TPCircularBuffer *buffer,
+                                                                                      TPCircularBufferBatch *batch) {
+#if TPCIRCULARBUFFER_CACHED_INDICES
+    // Start from a fresh view of the consumer: the cached view is only refreshed once the buffer
+    // appears full, so a stale one could otherwise limit every batch to less than the caller needs
+    _TPCircularBufferProducerFillCount(buffer, _TPCircularBufferAtomic(buffer), true);
+#endif
+    batch->bytes = (char *)TPCircularBufferHead(buffer, &batch->available, &batch->discard);
+    batch->length = 0;
+    return batch->bytes != NULL;
+}
+
+/*!
+ * Reserve space within a write batch
+ *
+ *  This gives you a pointer to write the given number of bytes to directly.
+ *
+ * @param batch The batch
+ * @param len Number of bytes to reserve
+ * @return Pointer to write to, or NULL if there's insufficient space remaining
+ */
+static __inline__ __attribute__((always_inline)) void *TPCircularBufferBatchReserve(TPCircularBufferBatch *batch,
+                                                                                    TPCircularBufferLength len) {
+    if ( batch->available - batch->length < len ) return NULL;
+    void *ptr = batch->bytes + batch->length;
+    batch->length += len;
+    return ptr;
+}
+
+/*!
+ * Copy bytes into a write batch
+ *
+ * @param batch The batch
+ * @param src Source buffer
+ * @param len Number of bytes in source buffer
+ * @return true if bytes copied, false if there was insufficient space remaining
+ */
+static __inline__ __attribute__((always_inline)) bool TPCircularBufferBatchAppendBytes(TPCircularBufferBatch *batch,
+                                                                                       const void *src,
+                                                                                       TPCircularBufferLength len) {
+    if ( batch->available - batch->length < len ) return false;
+    TPCircularBufferLength skip = batch->discard - batch->length;
+    if ( skip <= 0 ) {
+        _TPCircularBufferCopyIn(batch->bytes + batch->length, src, len);
+    } else if ( skip < len ) {
+        memcpy(batch->bytes + batch->length + skip, (const char *)src + skip, len - skip);
+    }
+    batch->length += len;
     return true;
 }
 
+/*!
+ * Publish a batch of writes
+ *
+ *  Marks everything added to the batch ready for reading, with a single update.
+ *
+ * @param buffer Circular buffer
+ * @param batch The batch
+ */
+static __inline__ __attribute__((always_inline)) void TPCircularBufferCommitWriteBatch(TPCircularBuffer *buffer,
+                                                                                       TPCircularBufferBatch *batch) {
+    if ( batch->length > 0 ) {
+        TPCircularBufferProduce(buffer, batch->length);
+    }
+    batch->bytes = NULL;
+    batch->available = batch->length = batch->discard = 0;
+}
+
+/*!
+ * Begin a batch of reads
+ *
+ *  Takes a snapshot of the bytes available at the end of the buffer. Use
+ *  TPCircularBufferBatchRead to take records from it, then
+ *  TPCircularBufferCommitReadBatch to free everything read at once.
+ *
+ * @param buffer Circular buffer
+ * @param batch The batch to initialise
+ * @return true if there are bytes to read, false if the buffer is empty
+ */
+static __inline__ __attribute__((always_inline)) bool TPCircularBufferBeginReadBatch(TPCircularBuffer *buffer,
+                                                                                     TPCircularBufferBatch *batch) {
+    batch->bytes = (char *)TPCircularBufferTail(buffer, &batch->available);
+    batch->length = batch->discard = 0;
+    return batch->bytes != NULL;
+}
+
+/*!
+ * Read from a read batch
+ *
+ * @param batch The batch
+ * @param len Number of bytes to read
+ * @return Pointer to the next len bytes, or NULL if fewer remain in the batch
+ */
+static __inline__ __attribute__((always_inline)) const void *TPCircularBufferBatchRead(TPCircularBufferBatch *batch,
+                                                                                       TPCircularBufferLength len) {
+    if ( batch->available - batch->length < len ) return NULL;
+    const void *ptr = batch->bytes + batch->length;
+    batch->length += len;
+    return ptr;
+}
+
+/*!
+ * Copy bytes out of a read batch
+ *
+ * @param batch The batch
+ * @param dst Destination buffer
+ * @param len Number of bytes to copy
+ * @return true if bytes copied, false if fewer remain in the batch
+ */
+static __inline__ __attribute__((always_inline)) bool TPCircularBufferBatchReadBytes(TPCircularBufferBatch *batch,
+                                                                                     void *dst,
+                                                                                     TPCircularBufferLength len) {
+    if ( batch->available - batch->length < len ) return false;
+    _TPCircularBufferCopyOut(dst, batch->bytes + batch->length, len);
+    batch->length += len;
+    return true;
+}
+
+/*!
+ * Finish a batch of reads
+ *
+ *  Frees up everything read from the batch, with a single update.
+ *
+ * @param buffer Circular buffer
+ * @param batch The batch
+ */
+static __inline__ __attribute__((always_inline)) void TPCircularBufferCommitReadBatch(TPCircularBuffer *buffer,
+                                                                                      TPCircularBufferBatch *batch) {
+    if ( batch->length > 0 ) {
+        TPCircularBufferConsume(buffer, batch->length);
+    }
+    batch->bytes = NULL;
+    batch->available = batch->length = 0;
+}
+
 #pragma mark - Deprecated
 
 /*!
@@ -243,9 +1120,8 @@ static __inline__ __attribute__((always_inline)) bool TPCircularBufferProduceByt
  */
 static __inline__ __attribute__((always_inline))
 __deprecated_msg("use TPCircularBufferSetAtomic(false) and TPCircularBufferConsume instead")
-void TPCircularBufferConsumeNoBarrier(TPCircularBuffer *buffer, int32_t amount) {
-    buffer->tail = (buffer->tail + amount) % buffer->length;
-    buffer->fillCount -= amount;
+void TPCircularBufferConsumeNoBarrier(TPCircularBuffer *buffer, TPCircularBufferLength amount) {
+    _TPCircularBufferAdvanceTail(buffer, amount, false);
 }
 
 /*!
@@ -253,10 +1129,8 @@ void TPCircularBufferConsumeNoBarrier(TPCircularBuffer *buffer, int32_t amount)
  */
 static __inline__ __attribute__((always_inline))
 __deprecated_msg("use TPCircularBufferSetAtomic(false) and TPCircularBufferProduce instead")
-void TPCircularBufferProduceNoBarrier(TPCircularBuffer *buffer, int32_t amount) {
-    buffer->head = (buffer->head + amount) % buffer->length;
-    buffer->fillCount += amount;
-    assert(buffer->fillCount <= buffer->length);
+void TPCircularBufferProduceNoBarrier(TPCircularBuffer *buffer, TPCircularBufferLength amount) {
+    _TPCircularBufferAdvanceHead(buffer, amount, false);
 }
 
 #ifdef __cplusplus